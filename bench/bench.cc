@@ -0,0 +1,53 @@
+#include "bench.h"
+
+#include <chrono>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+f64 bench_wall_sec() {
+    using namespace std::chrono;
+    return duration<f64>(steady_clock::now().time_since_epoch()).count();
+}
+
+f64 bench_cpu_sec() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;   u.HighPart = user.dwHighDateTime;
+    // FILETIME is in 100ns units
+    return (f64)(k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (f64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (f64)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+usize bench_peak_rss() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return (usize)counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (usize)usage.ru_maxrss;
+#else
+    // linux reports it in kilobytes
+    return (usize)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "utils/defines.h"
+
+// wall clock time in seconds, only useful for differences
+f64 bench_wall_sec();
+// cpu time used by the whole process (all threads) in seconds
+f64 bench_cpu_sec();
+// peak resident set size of the process in bytes
+usize bench_peak_rss();
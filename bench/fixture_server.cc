@@ -0,0 +1,205 @@
+#include "fixture_server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+
+void FixtureServer::add_file(const char *name, const u8 *data, usize len) {
+    files.push_back({ name, std::vector<u8>(data, data + len) });
+}
+
+bool FixtureServer::start(u16 server_port, usize max_payload) {
+    if (!skInit()) return false;
+
+    payload_len = max_payload;
+    payload = new u8[payload_len];
+    for (usize i = 0; i < payload_len; ++i) {
+        payload[i] = payload_byte(i);
+    }
+
+    listener = skOpen(SOCK_TCP);
+    if (listener == INVALID_SOCKET) return false;
+
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+
+    if (!skBind(listener, "127.0.0.1", server_port) || !skListen(listener)) {
+        skClose(listener);
+        listener = INVALID_SOCKET;
+        return false;
+    }
+
+    port = server_port;
+    running = true;
+    accept_thread = std::thread([this](){ accept_loop(); });
+    return true;
+}
+
+void FixtureServer::stop() {
+    if (!running) return;
+    running = false;
+
+    // wake up the blocking accept with a dummy connection
+    socket_t wake = skOpen(SOCK_TCP);
+    skConnect(wake, "127.0.0.1", port);
+    skClose(wake);
+
+    accept_thread.join();
+    skClose(listener);
+    listener = INVALID_SOCKET;
+
+    // connections are closed by the clients, give them a moment to finish
+    while (open_conns > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    delete[] payload;
+    payload = nullptr;
+    skCleanup();
+}
+
+void FixtureServer::accept_loop() {
+    while (running) {
+        socket_t client = skAccept(listener);
+        if (client == INVALID_SOCKET) continue;
+        if (!running) {
+            skClose(client);
+            break;
+        }
+
+        ++open_conns;
+        std::thread([this, client](){
+            serve(client);
+            skClose(client);
+            --open_conns;
+        }).detach();
+    }
+}
+
+bool FixtureServer::send_all(socket_t client, const void *data, usize len) {
+    const char *cur = (const char *)data;
+    while (len > 0) {
+        int chunk = len > (1 << 20) ? (1 << 20) : (int)len;
+        int sent = skSend(client, cur, chunk);
+        if (sent <= 0) return false;
+        cur += sent;
+        len -= (usize)sent;
+    }
+    return true;
+}
+
+bool FixtureServer::send_body(socket_t client, const void *data, usize len) {
+    usize rate = bandwidth;
+    if (rate == 0) return send_all(client, data, len);
+
+    // slices of ~10ms, each one sent when the ones before it are due
+    using clock = std::chrono::steady_clock;
+    usize slice = rate / 100 > 1024 ? rate / 100 : 1024;
+    const u8 *cur = (const u8 *)data;
+    auto start = clock::now();
+    usize sent = 0;
+    while (sent < len) {
+        usize n = len - sent < slice ? len - sent : slice;
+        if (!send_all(client, cur + sent, n)) return false;
+        sent += n;
+        std::this_thread::sleep_until(start + std::chrono::microseconds((u64)((f64)sent * 1e6 / (f64)rate)));
+    }
+    return true;
+}
+
+void FixtureServer::serve(socket_t client) {
+    std::string request;
+    char buf[4096];
+
+    while (true) {
+        usize head_end = request.find("\r\n\r\n");
+        while (head_end == std::string::npos) {
+            int read = skReceive(client, buf, sizeof(buf));
+            if (read <= 0) return;
+            request.append(buf, (usize)read);
+            head_end = request.find("\r\n\r\n");
+        }
+
+        std::string head = request.substr(0, head_end);
+        request.erase(0, head_end + 4);
+
+        // GET /kind/<bytes> HTTP/1.1
+        usize path_start = head.find(' ');
+        usize path_end = head.find(' ', path_start + 1);
+        if (path_start == std::string::npos || path_end == std::string::npos) return;
+        std::string path = head.substr(path_start + 1, path_end - path_start - 1);
+
+        bool close = head.find("Connection: close") != std::string::npos;
+        int latency = latency_ms;
+        if (latency > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+        }
+
+        char header[256];
+        if (path.compare(0, 7, "/files/") == 0) {
+            std::string name = path.substr(7, path.find('?') - 7);
+            const file *found = nullptr;
+            for (const auto &f : files) {
+                if (f.name == name) found = &f;
+            }
+
+            if (!found) {
+                snprintf(header, sizeof(header),
+                    "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n%s\r\n",
+                    close ? "Connection: close\r\n" : ""
+                );
+                if (!send_all(client, header, strlen(header))) return;
+            }
+            else {
+                snprintf(header, sizeof(header),
+                    "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                    "Content-Length: %zu\r\n%s\r\n",
+                    found->data.size(), close ? "Connection: close\r\n" : ""
+                );
+                if (!send_all(client, header, strlen(header))) return;
+                if (!send_body(client, found->data.data(), found->data.size())) return;
+            }
+
+            if (close) return;
+            continue;
+        }
+
+        usize slash = path.rfind('/');
+        usize len = strtoull(path.c_str() + slash + 1, nullptr, 10);
+        if (len > payload_len) len = payload_len;
+        bool chunked = path.compare(0, 9, "/chunked/") == 0;
+
+        if (chunked) {
+            snprintf(header, sizeof(header),
+                "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                "Transfer-Encoding: chunked\r\n%s\r\n",
+                close ? "Connection: close\r\n" : ""
+            );
+            if (!send_all(client, header, strlen(header))) return;
+
+            const usize chunk_size = 16 * 1024;
+            for (usize i = 0; i < len; i += chunk_size) {
+                usize n = len - i < chunk_size ? len - i : chunk_size;
+                char size_line[32];
+                snprintf(size_line, sizeof(size_line), "%zx\r\n", n);
+                if (!send_all(client, size_line, strlen(size_line))) return;
+                if (!send_body(client, payload + i, n)) return;
+                if (!send_all(client, "\r\n", 2)) return;
+            }
+            if (!send_all(client, "0\r\n\r\n", 5)) return;
+        }
+        else {
+            snprintf(header, sizeof(header),
+                "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                "Content-Length: %zu\r\n%s\r\n",
+                len, close ? "Connection: close\r\n" : ""
+            );
+            if (!send_all(client, header, strlen(header))) return;
+            if (!send_body(client, payload, len)) return;
+        }
+
+        if (close) return;
+    }
+}
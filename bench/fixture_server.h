@@ -0,0 +1,55 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <socket.h>
+
+#include "utils/defines.h"
+
+// minimal HTTP/1.1 server running in the same process as the benchmarks,
+// it supports keep-alive and serves generated payloads:
+//   GET /page/<bytes>    -> <bytes> long body sent with Content-Length
+//   GET /chunked/<bytes> -> <bytes> long body sent with chunked encoding
+//   GET /files/<name>    -> a file added with add_file, anything after a ?
+//                           is ignored so the same file can have many urls
+// it doesn't allocate through xmalloc, so it doesn't show up in the stats
+struct FixtureServer {
+    bool start(u16 port, usize max_payload = 32 * 1024 * 1024);
+    void stop();
+
+    // copies the data, must be called before start
+    void add_file(const char *name, const u8 *data, usize len);
+
+    // every response waits latency_ms before the first byte and its body is
+    // sent at most bandwidth bytes per second per connection (0 is unlimited)
+    std::atomic<int> latency_ms = 0;
+    std::atomic<usize> bandwidth = 0;
+
+    // byte at index i of every payload
+    static u8 payload_byte(usize i) { return (u8)((i * 7) % 251); }
+
+    u16 port = 0;
+
+private:
+    void accept_loop();
+    void serve(socket_t client);
+    bool send_all(socket_t client, const void *data, usize len);
+    // send_all but keeping to bandwidth
+    bool send_body(socket_t client, const void *data, usize len);
+
+    struct file {
+        std::string name;
+        std::vector<u8> data;
+    };
+
+    socket_t listener = INVALID_SOCKET;
+    std::thread accept_thread;
+    std::atomic<bool> running = false;
+    std::atomic<int> open_conns = 0;
+    u8 *payload = nullptr;
+    usize payload_len = 0;
+    std::vector<file> files;
+};
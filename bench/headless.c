@@ -0,0 +1,23 @@
+// the parts of sokol the framework links against, without a window or a
+// gpu: sokol_gfx with the dummy backend, sokol_time, and the few sokol_app
+// calls made by initFramework and beginFrame, which the benchmarks never use
+
+#define SOKOL_IMPL
+#define SOKOL_DUMMY_BACKEND
+#include <sokol_gfx.h>
+#include <sokol_time.h>
+
+// only the declarations, the implementation would bring a window and main()
+#undef SOKOL_IMPL
+#include <sokol_app.h>
+#include <sokol_glue.h>
+
+int sapp_width(void) { return 0; }
+int sapp_height(void) { return 0; }
+float sapp_widthf(void) { return 0.f; }
+float sapp_heightf(void) { return 0.f; }
+
+sg_context_desc sapp_sgcontext(void) {
+    sg_context_desc desc = {0};
+    return desc;
+}
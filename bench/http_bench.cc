@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "utils/http.h"
+#include "utils/xmalloc.h"
+#include "utils/utils.h"
+
+#include "bench.h"
+#include "fixture_server.h"
+
+// downloads the same page over and over from a local server and reports
+// how much cpu time and memory each page costs the client
+//
+// usage: http-bench [pages] [page size in KB] [port]
+
+struct run_result {
+    f64 wall;
+    f64 cpu;
+    xmalloc_stats allocs;
+    usize bytes;
+    usize buffer_cap;
+    bool ok;
+};
+
+static run_result run(u16 port, const char *path, int pages, usize page_len, bool reuse_buffer) {
+    run_result out = {};
+    out.ok = true;
+
+    vec<u8> shared;
+
+    xmalloc_stats before = xmalloc_get_stats();
+    f64 wall = bench_wall_sec();
+    f64 cpu = bench_cpu_sec();
+
+    for (int i = 0; i < pages; ++i) {
+        vec<u8> local;
+        vec<u8> &body = reuse_buffer ? shared : local;
+
+        auto res = http::get("127.0.0.1", path, body, port);
+        if (res.bad() || res.result.body.len != page_len) {
+            out.ok = false;
+            break;
+        }
+        out.bytes += res.result.body.len;
+        out.buffer_cap = body.cap;
+    }
+
+    out.wall = bench_wall_sec() - wall;
+    out.cpu = bench_cpu_sec() - cpu;
+    xmalloc_stats after = xmalloc_get_stats();
+    out.allocs.count = after.count - before.count;
+    out.allocs.bytes = after.bytes - before.bytes;
+    return out;
+}
+
+static void report(const char *name, const run_result &r, int pages, usize page_len) {
+    if (!r.ok) {
+        printf("%-28s FAILED\n", name);
+        return;
+    }
+
+    f64 mb = (f64)r.bytes / (1024.0 * 1024.0);
+    printf(
+        "%-28s %8.1f pages/s %8.1f MB/s %8.3f ms cpu/page %8.1f allocs/page %10.1f KB alloc/page %8.2f buffer/page\n",
+        name,
+        pages / r.wall,
+        mb / r.wall,
+        r.cpu * 1000.0 / pages,
+        (f64)r.allocs.count / pages,
+        (f64)r.allocs.bytes / 1024.0 / pages,
+        (f64)r.buffer_cap / (f64)page_len
+    );
+}
+
+int main(int argc, char **argv) {
+    int pages = argc > 1 ? atoi(argv[1]) : 200;
+    usize page_kb = argc > 2 ? strtoull(argv[2], nullptr, 10) : 2048;
+    u16 port = argc > 3 ? (u16)atoi(argv[3]) : 8123;
+
+    usize page_len = page_kb * 1024;
+
+    FixtureServer server;
+    if (!server.start(port, page_len)) {
+        printf("couldn't start the fixture server on port %d\n", port);
+        return 1;
+    }
+
+    printf("%d pages of %llu KB from 127.0.0.1:%d\n\n", pages, (unsigned long long)page_kb, port);
+
+    struct {
+        const char *name;
+        const char *kind;
+        bool reuse;
+    } runs[] = {
+        { "content-length",         "page",    true },
+        { "content-length (fresh)", "page",    false },
+        { "chunked",                "chunked", true },
+        { "chunked (fresh)",        "chunked", false },
+    };
+
+    for (const auto &r : runs) {
+        const char *path = format("/%s/%llu", r.kind, (unsigned long long)page_len);
+        // keep our own copy, format reuses its buffer
+        str uri = path;
+
+        // warm up the connection pool
+        run(port, uri.buf, 1, page_len, r.reuse);
+        report(r.name, run(port, uri.buf, pages, page_len, r.reuse), pages, page_len);
+    }
+
+    printf("\npeak rss: %.1f MB\n", (f64)bench_peak_rss() / (1024.0 * 1024.0));
+
+    http::shutdown();
+    server.stop();
+    return 0;
+}
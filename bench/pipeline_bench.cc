@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dir.h>
+#include <file.h>
+
+#include "utils/http.h"
+#include "utils/utils.h"
+#include "framework/framework.h"
+#include "loader.h"
+
+#include "bench.h"
+#include "fixture_server.h"
+
+// runs the reader's loading pipeline (fetch, decode, handoff to the main
+// thread) without a window against a local server, and reports how fast
+// the pages come out of it. nothing is uploaded, the pages are freed as
+// soon as they arrive. without a directory a few generated pages are used
+//
+// usage: jojo-bench [fixture dir or -] [pages] [latency ms] [bandwidth KB/s] [workers] [port]
+
+constexpr int bench_thumb_height = 128;
+// a page counts as failed if nothing arrives for this long
+constexpr f64 stall_timeout_sec = 30.0;
+
+struct fixture {
+    std::string name;
+    usize size;
+};
+
+static void put_u16(std::vector<u8> &out, u16 v) {
+    out.push_back((u8)v);
+    out.push_back((u8)(v >> 8));
+}
+
+static void put_u32(std::vector<u8> &out, u32 v) {
+    put_u16(out, (u16)v);
+    put_u16(out, (u16)(v >> 16));
+}
+
+// 24 bit bmp with panel borders and some noise, grey pages go through the
+// greyscale detection like most real pages do
+static std::vector<u8> make_page(int width, int height, bool grey, u32 seed) {
+    int row = (width * 3 + 3) & ~3;
+    std::vector<u8> out;
+    out.reserve(54 + (usize)row * height);
+
+    out.push_back('B'); out.push_back('M');
+    put_u32(out, 54 + (u32)row * height);
+    put_u32(out, 0);
+    put_u32(out, 54);
+    put_u32(out, 40);
+    put_u32(out, (u32)width);
+    put_u32(out, (u32)height);
+    put_u16(out, 1);
+    put_u16(out, 24);
+    put_u32(out, 0);
+    put_u32(out, (u32)row * height);
+    put_u32(out, 2835);
+    put_u32(out, 2835);
+    put_u32(out, 0);
+    put_u32(out, 0);
+
+    u32 state = seed * 2654435761u + 1;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            state = state * 1664525u + 1013904223u;
+            bool border = (x % (width / 2) < 6) || (y % (height / 3) < 6);
+            u8 v = border ? 0 : (u8)(200 + (state >> 27));
+            u8 tint = grey ? v : (u8)(v - (x * 40 / width));
+            out.push_back(tint);
+            out.push_back(v);
+            out.push_back(v);
+        }
+        for (int pad = width * 3; pad < row; ++pad) {
+            out.push_back(0);
+        }
+    }
+    return out;
+}
+
+static bool load_fixtures(const char *path, FixtureServer &server, std::vector<fixture> &out) {
+    if (strcmp(path, "-") == 0) {
+        for (int i = 0; i < 4; ++i) {
+            std::vector<u8> page = make_page(900, 1300, i != 0, (u32)i);
+            std::string name = format("page-%d.bmp", i);
+            server.add_file(name.c_str(), page.data(), page.size());
+            out.push_back({ name, page.size() });
+        }
+        return true;
+    }
+
+    dir_t dir = dirOpen(path);
+    if (!dirValid(dir)) {
+        printf("couldn't open %s\n", path);
+        return false;
+    }
+
+    dir_entry_t *entry = nullptr;
+    while ((entry = dirNext(dir))) {
+        if (entry->type != FS_TYPE_FILE) continue;
+        const char *full = format("%s/%s", path, entry->name.buf);
+        fread_buf_t data = fileReadWhole(full);
+        if (!data.buf) continue;
+
+        server.add_file(entry->name.buf, (const u8 *)data.buf, data.len);
+        out.push_back({ entry->name.buf, data.len });
+        free(data.buf);
+    }
+    dirClose(dir);
+
+    if (out.empty()) {
+        printf("no files in %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *fixture_dir = argc > 1 ? argv[1] : "-";
+    int pages = argc > 2 ? atoi(argv[2]) : 200;
+    int latency = argc > 3 ? atoi(argv[3]) : 0;
+    usize bandwidth_kb = argc > 4 ? strtoull(argv[4], nullptr, 10) : 0;
+    int workers = argc > 5 ? atoi(argv[5]) : default_download_workers;
+    u16 port = argc > 6 ? (u16)atoi(argv[6]) : 8124;
+    if (pages <= 0 || workers <= 0) {
+        printf("usage: %s [fixture dir or -] [pages] [latency ms] [bandwidth KB/s] [workers] [port]\n", argv[0]);
+        return 1;
+    }
+
+    FixtureServer server;
+    std::vector<fixture> fixtures;
+    if (!load_fixtures(fixture_dir, server, fixtures)) {
+        return 1;
+    }
+    server.latency_ms = latency;
+    server.bandwidth = bandwidth_kb * 1024;
+    if (!server.start(port, 0)) {
+        printf("couldn't start the fixture server on port %d\n", port);
+        return 1;
+    }
+
+    initDecodePool(0);
+    setGreyscaleDetection(true);
+    setImageMipmaps(true);
+
+    // the urls have to outlive the jobs, like the chapter lists do
+    std::string text;
+    usize encoded_bytes = 0;
+    for (int i = 0; i < pages; ++i) {
+        const fixture &f = fixtures[(usize)i % fixtures.size()];
+        text += format("http://127.0.0.1:%d/files/%s?%d\n", port, f.name.c_str(), i);
+        encoded_bytes += f.size;
+    }
+    str urls(text.c_str(), text.size());
+    vec<str_view> lines = split_lines(urls);
+
+    printf(
+        "%d pages from %d fixtures, %d ms latency, %s bandwidth, %d workers\n\n",
+        pages, (int)fixtures.size(), latency,
+        bandwidth_kb ? format("%llu KB/s", (unsigned long long)bandwidth_kb) : "unlimited",
+        workers
+    );
+
+    // no caches, every page goes through the whole pipeline
+    Downloader downloader;
+    downloader.init(nullptr, nullptr, workers);
+    downloader.set_thumbnails(bench_thumb_height);
+
+    f64 start = bench_wall_sec();
+    f64 cpu = bench_cpu_sec();
+    for (int i = 0; i < pages; ++i) {
+        downloader.push({ lines[(usize)i], i, i + 1, 0, downloader.cur_generation(), true, 0, 0 });
+    }
+
+    int done = 0;
+    int failed = 0;
+    f64 first_page = 0.0;
+    f64 last_progress = start;
+    usize decoded_bytes = 0;
+    while (done + failed < pages) {
+        LoadedPage page;
+        if (!downloader.pop_loaded(page)) {
+            if (bench_wall_sec() - last_progress > stall_timeout_sec) {
+                printf("no pages for %.0f seconds, giving up\n", stall_timeout_sec);
+                failed = pages - done;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+
+        last_progress = bench_wall_sec();
+        if (page.success) {
+            if (done == 0) first_page = last_progress - start;
+            decoded_bytes += imageDataSize(page.img);
+            ++done;
+        }
+        else {
+            ++failed;
+        }
+        freeImage(page.img);
+        freeImage(page.thumb);
+        downloader.upload_done(0.0);
+    }
+
+    f64 wall = bench_wall_sec() - start;
+    cpu = bench_cpu_sec() - cpu;
+
+    StageStats stats[STAGE_COUNT];
+    downloader.get_stats(stats);
+
+    printf("pages:              %d ok, %d failed\n", done, failed);
+    printf("throughput:         %.1f pages/s\n", done / wall);
+    printf("downloaded:         %.1f MB/s\n", (f64)encoded_bytes / (1024.0 * 1024.0) / wall);
+    printf("decoded:            %.1f MB/s\n", (f64)decoded_bytes / (1024.0 * 1024.0) / wall);
+    printf("time to first page: %.1f ms\n", first_page * 1000.0);
+    printf("cpu:                %.2f ms/page\n", done ? cpu * 1000.0 / done : 0.0);
+    for (const auto &s : stats) {
+        printf("%-19s %.2f ms wait, %.2f ms work\n", format("%s:", s.name), s.avg_wait_ms, s.avg_work_ms);
+    }
+    printf("peak rss:           %.1f MB\n", (f64)bench_peak_rss() / (1024.0 * 1024.0));
+
+    downloader.shutdown();
+    cleanupDecodePool();
+    http::shutdown();
+    server.stop();
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,323 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/xmalloc.h"
+#include "utils/vec.h"
+#include "utils/str.h"
+#include "utils/map.h"
+#include "utils/utils.h"
+#include "page_layout.h"
+
+#include "bench.h"
+
+// times the hand rolled containers in src/utils next to their standard
+// library equivalents. every case runs until it took at least the minimum
+// time and reports the time and the allocations per operation
+//
+// usage: utils-bench [filter] [min ms per case]
+
+// the standard containers allocate through operator new, send it to xmalloc
+// so both sides show up in the same stats
+void *operator new(size_t size) { return xmalloc(size ? size : 1); }
+void *operator new[](size_t size) { return xmalloc(size ? size : 1); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+static f64 min_time = 0.2;
+static const char *filter = nullptr;
+
+// results go here so the compiler can't throw the work away
+static volatile usize sink = 0;
+
+// fn does one batch of work and returns how many operations it did,
+// bytes_per_batch is only used for the MB/s column
+template<typename Fn>
+static void bench(const char *name, usize bytes_per_batch, Fn &&fn) {
+    if (filter && !strstr(name, filter)) return;
+
+    // warm up the caches and the allocator
+    fn();
+
+    u64 ops = 0;
+    u64 batches = 0;
+    xmalloc_stats before = xmalloc_get_stats();
+    f64 start = bench_wall_sec();
+    f64 elapsed = 0.0;
+    do {
+        ops += fn();
+        ++batches;
+        elapsed = bench_wall_sec() - start;
+    } while (elapsed < min_time);
+    xmalloc_stats after = xmalloc_get_stats();
+
+    printf(
+        "%-36s %10.2f ns/op %8.3f allocs/op %10.1f B/op",
+        name,
+        elapsed * 1e9 / (f64)ops,
+        (f64)(after.count - before.count) / (f64)ops,
+        (f64)(after.bytes - before.bytes) / (f64)ops
+    );
+    if (bytes_per_batch) {
+        printf(" %8.1f MB/s", (f64)(bytes_per_batch * batches) / (1024.0 * 1024.0) / elapsed);
+    }
+    printf("\n");
+}
+
+static void vec_benches() {
+    constexpr usize count = 100000;
+    constexpr usize chunk = 64;
+
+    static int chunk_data[chunk] = {};
+
+    bench("vec<int>::append", 0, [] {
+        vec<int> v;
+        for (usize i = 0; i < count; ++i) v.append((int)i);
+        sink += v.len;
+        return (u64)count;
+    });
+    bench("std::vector<int>::push_back", 0, [] {
+        std::vector<int> v;
+        for (usize i = 0; i < count; ++i) v.push_back((int)i);
+        sink += v.size();
+        return (u64)count;
+    });
+
+    bench("vec<int>::resize +1", 0, [] {
+        vec<int> v;
+        for (usize i = 1; i <= count; ++i) v.resize(i, (int)i);
+        sink += v.len;
+        return (u64)count;
+    });
+    bench("std::vector<int>::resize +1", 0, [] {
+        std::vector<int> v;
+        for (usize i = 1; i <= count; ++i) v.resize(i, (int)i);
+        sink += v.size();
+        return (u64)count;
+    });
+
+    // one op is one element, appended 64 at a time
+    bench("vec<int>::append_slice", 0, [] {
+        vec<int> v;
+        for (usize i = 0; i < count; i += chunk) v.append_slice({ chunk_data, chunk });
+        sink += v.len;
+        return (u64)count;
+    });
+    bench("std::vector<int>::insert", 0, [] {
+        std::vector<int> v;
+        for (usize i = 0; i < count; i += chunk) v.insert(v.end(), chunk_data, chunk_data + chunk);
+        sink += v.size();
+        return (u64)count;
+    });
+}
+
+static void str_benches() {
+    for (usize size : { 16, 256, 4096 }) {
+        std::string text(size, 'a');
+        str source(text.c_str(), text.size());
+
+        bench(format("str copy (%llu)", (unsigned long long)size), 0, [&] {
+            for (int i = 0; i < 1000; ++i) {
+                str copy = source;
+                sink += copy.len;
+                free(copy.buf);
+            }
+            return (u64)1000;
+        });
+        bench(format("std::string copy (%llu)", (unsigned long long)size), 0, [&] {
+            for (int i = 0; i < 1000; ++i) {
+                std::string copy = text;
+                sink += copy.size();
+            }
+            return (u64)1000;
+        });
+
+        free(source.buf);
+    }
+}
+
+static const char *header_names[] = {
+    "Content-Type", "Content-Length", "Transfer-Encoding", "Connection",
+    "Date", "Server", "Cache-Control", "ETag", "Last-Modified", "Accept-Ranges",
+    "Vary", "Expires", "Age", "Location", "Content-Encoding", "Set-Cookie",
+    "Strict-Transport-Security", "X-Content-Type-Options", "X-Frame-Options", "X-Cache",
+};
+
+static std::string header_name(usize i) {
+    constexpr usize named = sizeof(header_names) / sizeof(*header_names);
+    return i < named ? header_names[i] : format("X-Header-%llu", (unsigned long long)i);
+}
+
+static std::string lower(std::string_view s) {
+    std::string out(s);
+    for (char &c : out) c = (char)tolower((uchar)c);
+    return out;
+}
+
+// http.cc looks headers up by their lowercase name, the server sends them
+// capitalized. the std map is given lowercase keys on both sides, paying
+// for the conversion on every lookup like a case insensitive map would
+static void map_benches() {
+    for (usize keys : { 10, 30, 100 }) {
+        std::vector<std::string> names, lookups;
+        for (usize i = 0; i < keys; ++i) {
+            names.push_back(header_name(i));
+            lookups.push_back(lower(names.back()));
+        }
+        std::string value = "some header value";
+        str_view value_view = { value.data(), value.size() };
+
+        // one op is one set, freeing the map is part of it
+        bench(format("header_map::set (%llu keys)", (unsigned long long)keys), 0, [&] {
+            header_map m;
+            for (const auto &n : names) m.set({ n.data(), n.size() }, value_view);
+            sink += m.size();
+            return (u64)keys;
+        });
+        bench(format("std::unordered_map set (%llu keys)", (unsigned long long)keys), 0, [&] {
+            std::unordered_map<std::string, std::string> m;
+            for (const auto &n : names) m[lower(n)] = value;
+            sink += m.size();
+            return (u64)keys;
+        });
+
+        header_map m;
+        std::unordered_map<std::string, std::string> std_map;
+        for (const auto &n : names) {
+            m.set({ n.data(), n.size() }, value_view);
+            std_map[lower(n)] = value;
+        }
+
+        // one op is one lookup, every key once plus a miss
+        bench(format("header_map::get (%llu keys)", (unsigned long long)keys), 0, [&] {
+            for (const auto &l : lookups) sink += m.get({ l.data(), l.size() }).len;
+            sink += m.get({ "x-missing", 9 }).len;
+            return (u64)keys + 1;
+        });
+        bench(format("std::unordered_map find (%llu keys)", (unsigned long long)keys), 0, [&] {
+            for (const auto &l : lookups) sink += std_map.find(lower(l)) != std_map.end();
+            sink += std_map.find(lower("x-missing")) != std_map.end();
+            return (u64)keys + 1;
+        });
+    }
+}
+
+// a few MB of page urls, like a long chapter list
+static void split_lines_benches() {
+    std::string text;
+    usize lines = 0;
+    while (text.size() < 4 * 1024 * 1024) {
+        text += format("https://example.com/manga/jojo/chapter-%llu/page-%llu.jpg\n", (unsigned long long)(lines / 40), (unsigned long long)(lines % 40));
+        // chapter lists have empty lines between chapters
+        if (lines % 40 == 39) text += "\n";
+        ++lines;
+    }
+    str source(text.c_str(), text.size());
+
+    // one op is one line
+    bench("split_lines", text.size(), [&] {
+        vec<str_view> out = split_lines(source);
+        sink += out.len;
+        return (u64)lines;
+    });
+    bench("std::string_view split", text.size(), [&] {
+        std::vector<std::string_view> out;
+        std::string_view view = text;
+        usize from = 0;
+        while (from < view.size()) {
+            usize end = view.find('\n', from);
+            if (end == std::string_view::npos) end = view.size();
+            if (end > from) out.push_back(view.substr(from, end - from));
+            from = end + 1;
+        }
+        sink += out.size();
+        return (u64)lines;
+    });
+
+    free(source.buf);
+}
+
+static void utf8_benches() {
+    // ascii only, and ascii mixed with two and three byte codepoints like
+    // the titles on the site
+    std::string ascii, mixed;
+    while (ascii.size() < 1024 * 1024) {
+        ascii += "Part 4 Diamond is Unbreakable, Chapter 12: ";
+        // ジョジョ and é à, escaped so every compiler reads them the same way
+        mixed += "Part 4 \xe3\x82\xb8\xe3\x83\xa7\xe3\x82\xb8\xe3\x83\xa7, Chapitre 12 \xc3\xa9 \xc3\xa0: ";
+    }
+
+    for (const std::string *text : { &ascii, &mixed }) {
+        usize runes = 0;
+        const char *s = text->c_str();
+        const char *end = s + text->size();
+        while (s < end) {
+            utf8_decode(&s);
+            ++runes;
+        }
+
+        // one op is one codepoint
+        bench(text == &ascii ? "utf8_decode (ascii)" : "utf8_decode (mixed)", text->size(), [text, runes] {
+            const char *s = text->c_str();
+            const char *end = s + text->size();
+            u32 sum = 0;
+            while (s < end) {
+                sum += (u32)utf8_decode(&s);
+            }
+            sink += sum;
+            return (u64)runes;
+        });
+    }
+}
+
+// what the scroll mode does every frame to find the pages in the window
+static void layout_benches() {
+    for (usize pages : { 100, 10000 }) {
+        PageLayout layout;
+        layout.gap = 8.0;
+        u32 state = 1;
+        for (usize i = 0; i < pages; ++i) {
+            state = state * 1664525u + 1013904223u;
+            // mostly single pages with some double spreads
+            layout.append(state % 8 == 0 ? 0.7 : 1.45);
+        }
+
+        constexpr double width = 1280.0;
+        constexpr usize lookups = 1000;
+        std::vector<double> ys;
+        for (usize i = 0; i < lookups; ++i) {
+            state = state * 1664525u + 1013904223u;
+            ys.push_back(layout.total(width) * (double)(state >> 8) / (double)(1u << 24));
+        }
+
+        // one op is one lookup
+        bench(format("PageLayout::page_at (%llu pages)", (unsigned long long)pages), 0, [&] {
+            for (double y : ys) sink += layout.page_at(y, width);
+            return (u64)lookups;
+        });
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "-") != 0) filter = argv[1];
+    if (argc > 2) min_time = atof(argv[2]) / 1000.0;
+
+    vec_benches();
+    str_benches();
+    map_benches();
+    split_lines_benches();
+    utf8_benches();
+    layout_benches();
+
+    printf("\npeak rss: %.1f MB\n", (f64)bench_peak_rss() / (1024.0 * 1024.0));
+    return 0;
+}
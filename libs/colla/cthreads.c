@@ -65,6 +65,12 @@ bool thrJoin(cthread_t ctx, int *code) {
     return return_code != WAIT_FAILED && success;
 }
 
+int thrCpuCount(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
 // == MUTEX ============================================
 
 cmutex_t mtxInit(void) {
@@ -97,6 +103,37 @@ bool mtxUnlock(cmutex_t ctx) {
     return true;
 }
 
+// == CONDITION VARIABLE ===============================
+
+ccondvar_t condInit(void) {
+    CONDITION_VARIABLE *cond = malloc(sizeof(CONDITION_VARIABLE));
+    if(cond) {
+        InitializeConditionVariable(cond);
+    }
+    return (ccondvar_t)cond;
+}
+
+void condDestroy(ccondvar_t cond) {
+    // windows condition variables don't need to be destroyed
+    free((void *)cond);
+}
+
+bool condValid(ccondvar_t cond) {
+    return (void *)cond != NULL;
+}
+
+bool condWait(ccondvar_t cond, cmutex_t mtx) {
+    return SleepConditionVariableCS((CONDITION_VARIABLE *)cond, (CRITICAL_SECTION *)mtx, INFINITE);
+}
+
+void condWakeOne(ccondvar_t cond) {
+    WakeConditionVariable((CONDITION_VARIABLE *)cond);
+}
+
+void condWakeAll(ccondvar_t cond) {
+    WakeAllConditionVariable((CONDITION_VARIABLE *)cond);
+}
+
 
 #else
 #include <pthread.h>
@@ -162,6 +199,11 @@ bool thrJoin(cthread_t ctx, int *code) {
     return pthread_join((pthread_t)ctx, &result) != 0;
 }
 
+int thrCpuCount(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
 // == MUTEX ============================================
 
 cmutex_t mtxInit(void) {
@@ -195,4 +237,41 @@ bool mtxUnlock(cmutex_t ctx) {
     return pthread_mutex_unlock((pthread_mutex_t *)ctx) == 0;
 }
 
+// == CONDITION VARIABLE ===============================
+
+ccondvar_t condInit(void) {
+    pthread_cond_t *cond = malloc(sizeof(pthread_cond_t));
+
+    if(cond) {
+        int res = pthread_cond_init(cond, NULL);
+        if(res != 0) {
+            free(cond);
+            cond = NULL;
+        }
+    }
+
+    return (ccondvar_t)cond;
+}
+
+void condDestroy(ccondvar_t cond) {
+    pthread_cond_destroy((pthread_cond_t *)cond);
+    free((void *)cond);
+}
+
+bool condValid(ccondvar_t cond) {
+    return (void *)cond != NULL;
+}
+
+bool condWait(ccondvar_t cond, cmutex_t mtx) {
+    return pthread_cond_wait((pthread_cond_t *)cond, (pthread_mutex_t *)mtx) == 0;
+}
+
+void condWakeOne(ccondvar_t cond) {
+    pthread_cond_signal((pthread_cond_t *)cond);
+}
+
+void condWakeAll(ccondvar_t cond) {
+    pthread_cond_broadcast((pthread_cond_t *)cond);
+}
+
 #endif
\ No newline at end of file
@@ -24,6 +24,9 @@ int thrGetId(cthread_t ctx);
 void thrExit(int code);
 bool thrJoin(cthread_t ctx, int *code);
 
+// number of logical cores, at least 1
+int thrCpuCount(void);
+
 // == MUTEX ============================================
 
 typedef uintptr_t cmutex_t;
@@ -37,6 +40,20 @@ bool mtxLock(cmutex_t ctx);
 bool mtxTryLock(cmutex_t ctx);
 bool mtxUnlock(cmutex_t ctx);
 
+// == CONDITION VARIABLE ===============================
+
+typedef uintptr_t ccondvar_t;
+
+ccondvar_t condInit(void);
+void condDestroy(ccondvar_t cond);
+
+bool condValid(ccondvar_t cond);
+
+// mtx must be locked, it is unlocked while waiting and locked again before returning
+bool condWait(ccondvar_t cond, cmutex_t mtx);
+void condWakeOne(ccondvar_t cond);
+void condWakeAll(ccondvar_t cond);
+
 #ifdef __cplusplus
 // small c++ class to make mutexes easier to use
 struct lock_t {
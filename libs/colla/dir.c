@@ -98,10 +98,16 @@ dir_entry_t *dirNext(dir_t ctx) {
     return &dir->cur;
 }
 
+bool dirCreate(const char *path) {
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
 #else
 
 #include <dirent.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 // taken from https://sites.uclouvain.be/SystInfo/usr/include/dirent.h.html
 // hopefully shouldn't be needed
@@ -153,4 +159,8 @@ dir_entry_t *dirNext(dir_t ctx) {
     return &in->next;
 }
 
+bool dirCreate(const char *path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
 #endif
\ No newline at end of file
@@ -26,6 +26,9 @@ bool dirValid(dir_t ctx);
 
 dir_entry_t *dirNext(dir_t ctx);
 
+// returns true if the directory was created or already exists
+bool dirCreate(const char *path);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
\ No newline at end of file
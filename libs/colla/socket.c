@@ -1,6 +1,7 @@
 #include "socket.h"
 
 #include <stdio.h>
+#include <string.h>
 #include "tracelog.h"
 
 #ifndef NDEBUG
@@ -133,7 +134,7 @@ socket_t skAcceptPro(socket_t sock, sk_addr_t *addr, sk_len_t *addrlen) {
     return accept(sock, addr, addrlen);
 }
 
-bool skConnect(socket_t sock, const char *server, unsigned short server_port) {
+bool skResolve(const char *server, uint16_t port, sk_addrin_t *addr) {
     // TODO use getaddrinfo insetad
     struct hostent *host = gethostbyname(server);
     // if gethostbyname fails, inet_addr will also fail and return an easier to debug error
@@ -141,12 +142,18 @@ bool skConnect(socket_t sock, const char *server, unsigned short server_port) {
     if(host) {
         address = inet_ntoa(*(struct in_addr*)host->h_addr_list[0]);
     }
-    
-    sk_addrin_t addr;
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = inet_addr(address);
-    addr.sin_port = htons(server_port);
 
+    memset(addr, 0, sizeof(sk_addrin_t));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr(address);
+    addr->sin_port = htons(port);
+
+    return addr->sin_addr.s_addr != INADDR_NONE;
+}
+
+bool skConnect(socket_t sock, const char *server, unsigned short server_port) {
+    sk_addrin_t addr;
+    skResolve(server, server_port, &addr);
     return skConnectPro(sock, (sk_addr_t *) &addr, sizeof(addr));
 }
 
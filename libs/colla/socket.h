@@ -56,6 +56,8 @@ socket_t skOpenPro(int af, int type, int protocol);
 
 // Fill out a sk_addrin_t structure with "ip" and "port"
 sk_addrin_t skAddrinInit(const char *ip, uint16_t port);
+// Resolves a server (e.g. "127.0.0.1" or "google.com") and fills out "addr", returns true on success
+bool skResolve(const char *server, uint16_t port, sk_addrin_t *addr);
 
 // Closes a socket, returns true on success
 bool skClose(socket_t sock);
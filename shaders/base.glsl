@@ -27,8 +27,15 @@ out vec4 frag_colour;
 
 uniform sampler2D tex;
 
+uniform fs_params {
+    // 1 for single channel textures, which only have the red channel
+    float grey;
+};
+
 void main() {
-    frag_colour = texture(tex, fs_texc) * fs_colour;
+    vec4 texel = texture(tex, fs_texc);
+    if (grey > 0.5) texel = vec4(texel.rrr, 1.0);
+    frag_colour = texel * fs_colour;
     if (frag_colour.a == 0) discard;
 }
 
@@ -0,0 +1,276 @@
+#include "chapter_index.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "utils/http.h"
+#include "tracelog.h"
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+img_scanner::img_scanner(src_cb callback, void *udata)
+    : on_src(callback), userdata(udata) {}
+
+void img_scanner::feed(slice<const u8> data) {
+    for (usize i = 0; i < data.len; ++i) {
+        char c = (char)data.buf[i];
+
+        switch (state) {
+        case SCAN_TEXT:
+            if (c == '<') {
+                name_len = 0;
+                state = SCAN_TAG_NAME;
+            }
+            break;
+
+        case SCAN_TAG_NAME:
+            if (is_space(c) || c == '/' || c == '>') {
+                bool is_img = name_len == 3 && memcmp(name, "img", 3) == 0;
+                if (!is_img) {
+                    state = c == '>' ? SCAN_TEXT : SCAN_SKIP_TAG;
+                    break;
+                }
+                has_src = false;
+                state = SCAN_ATTR_SPACE;
+                if (c == '>') end_tag();
+            }
+            else if (name_len < sizeof(name)) {
+                name[name_len++] = (char)tolower((u8)c);
+            }
+            else {
+                state = SCAN_SKIP_TAG;
+            }
+            break;
+
+        case SCAN_SKIP_TAG:
+            if (c == '>') state = SCAN_TEXT;
+            break;
+
+        case SCAN_ATTR_SPACE:
+            if (c == '>') end_tag();
+            else if (!is_space(c) && c != '/') start_attr(c);
+            break;
+
+        case SCAN_ATTR_NAME:
+            if (c == '=') {
+                state = SCAN_ATTR_BEFORE_VALUE;
+            }
+            else if (c == '>') {
+                end_tag();
+            }
+            else if (is_space(c) || c == '/') {
+                state = SCAN_ATTR_AFTER_NAME;
+            }
+            else if (name_len < sizeof(name)) {
+                name[name_len++] = (char)tolower((u8)c);
+            }
+            else {
+                // too long to be src, but keep it from matching anyway
+                name_len = sizeof(name);
+            }
+            break;
+
+        case SCAN_ATTR_AFTER_NAME:
+            if (c == '=') state = SCAN_ATTR_BEFORE_VALUE;
+            else if (c == '>') end_tag();
+            else if (!is_space(c) && c != '/') start_attr(c);
+            break;
+
+        case SCAN_ATTR_BEFORE_VALUE:
+            if (is_space(c)) break;
+            if (c == '>') {
+                end_tag();
+                break;
+            }
+            is_src = name_len == 3 && memcmp(name, "src", 3) == 0;
+            value.clear();
+            quote = 0;
+            if (c == '"' || c == '\'') {
+                quote = c;
+            }
+            else {
+                value.append(c);
+            }
+            state = SCAN_ATTR_VALUE;
+            break;
+
+        case SCAN_ATTR_VALUE:
+            if (quote ? c == quote : is_space(c)) {
+                end_attr();
+                state = SCAN_ATTR_SPACE;
+            }
+            else if (!quote && c == '>') {
+                end_attr();
+                end_tag();
+            }
+            else {
+                value.append(c);
+            }
+            break;
+        }
+    }
+}
+
+void img_scanner::start_attr(char c) {
+    name_len = 0;
+    name[name_len++] = (char)tolower((u8)c);
+    state = SCAN_ATTR_NAME;
+}
+
+void img_scanner::end_attr() {
+    if (!is_src || has_src) return;
+    has_src = true;
+
+    // only the entities that can realistically show up in an url
+    static const struct { const char *entity; char c; } entities[] = {
+        { "&amp;", '&' }, { "&quot;", '"' }, { "&#39;", '\'' }, { "&lt;", '<' }, { "&gt;", '>' },
+    };
+
+    src.clear();
+    for (usize i = 0; i < value.len; ++i) {
+        char c = value[i];
+        if (c == '&') {
+            for (auto &e : entities) {
+                usize len = strlen(e.entity);
+                if (value.len - i >= len && memcmp(value.buf + i, e.entity, len) == 0) {
+                    c = e.c;
+                    i += len - 1;
+                    break;
+                }
+            }
+        }
+        src.append(c);
+    }
+}
+
+void img_scanner::end_tag() {
+    if (has_src && src.len > 0) {
+        on_src({ src.buf, src.len }, userdata);
+    }
+    has_src = false;
+    is_src = false;
+    state = SCAN_TEXT;
+}
+
+static void write_src(str_view src, void *udata) {
+    FILE *fp = (FILE *)udata;
+    fwrite(src.buf, 1, src.len, fp);
+    fputc('\n', fp);
+}
+
+static void feed_scanner(slice<const u8> data, void *udata) {
+    ((img_scanner *)udata)->feed(data);
+}
+
+enum fetch_result {
+    FETCH_OK,
+    FETCH_FAILED,
+    FETCH_REDIRECT,
+};
+
+static bool starts_with(str_view s, const char *prefix) {
+    usize len = strlen(prefix);
+    return s.len >= len && memcmp(s.buf, prefix, len) == 0;
+}
+
+// on a redirect that can be followed, url gets the new location
+static fetch_result check_response(int chapter, optional<http::res, http::req_error> &res, char *url, usize url_len) {
+    if (res.bad()) {
+        err("couldn't get chapter %d: %s", chapter, http::req_error_str(res.error));
+        return FETCH_FAILED;
+    }
+    int status = (int)res.result.status;
+    if (status >= 300 && status < 400) {
+        str_view location = res.result.fields.get("location");
+        http::url from = http::parse_url({ url, strlen(url) });
+        const char *problem = nullptr;
+
+        if (location.empty()) {
+            problem = "no location";
+        }
+        else if (starts_with(location, "https:")) {
+            problem = "https isn't supported";
+        }
+        else if (location[0] == '/') {
+            snprintf(url, url_len, "http://%.*s:%d%.*s", (int)from.host.len, from.host.buf, from.port, (int)location.len, location.buf);
+        }
+        else if (starts_with(location, "http://")) {
+            http::url to = http::parse_url(location);
+            if (to.host == from.host) {
+                snprintf(url, url_len, "%.*s", (int)location.len, location.buf);
+            }
+            else {
+                problem = "other host";
+            }
+        }
+        else {
+            problem = "unsupported location";
+        }
+
+        if (problem) {
+            err(
+                "couldn't get chapter %d: redirected (%d) to %.*s, %s",
+                chapter, status, (int)location.len, location.buf ? location.buf : "", problem
+            );
+            return FETCH_FAILED;
+        }
+        info("chapter %d redirected (%d) to %s", chapter, status, url);
+        return FETCH_REDIRECT;
+    }
+    if (status != http::STATUS_OK) {
+        err("couldn't get chapter %d: %d", chapter, status);
+        return FETCH_FAILED;
+    }
+    return FETCH_OK;
+}
+
+bool fetch_chapter_index(int chapter, const char *filename) {
+    char full_url[512];
+    snprintf(full_url, sizeof(full_url), chapter_url_fmt, chapter);
+
+    // written to a temporary file so a failed fetch doesn't leave a partial list
+    char tmp_name[256];
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", filename);
+
+    fetch_result result = FETCH_REDIRECT;
+    bool written = false;
+    for (int redirects = 0; result == FETCH_REDIRECT; ++redirects) {
+        if (redirects > max_chapter_redirects) {
+            err("couldn't get chapter %d: more than %d redirects", chapter, max_chapter_redirects);
+            result = FETCH_FAILED;
+            break;
+        }
+
+        // opened again on every redirect, the body of one can have images too
+        FILE *fp = fopen(tmp_name, "wb");
+        if (!fp) {
+            err("couldn't open %s", tmp_name);
+            return false;
+        }
+
+        // the html is scanned while it's still arriving
+        http::url url = http::parse_url({ full_url, strlen(full_url) });
+        img_scanner scanner(write_src, fp);
+        vec<u8> body;
+        auto res = http::get(url.host, url.uri, body, url.port, {}, { feed_scanner, &scanner });
+
+        result = check_response(chapter, res, full_url, sizeof(full_url));
+        written = fclose(fp) == 0;
+    }
+
+    if (result != FETCH_OK) {
+        remove(tmp_name);
+        return false;
+    }
+
+    remove(filename);
+    if (!written || rename(tmp_name, filename) != 0) {
+        err("couldn't write %s", filename);
+        remove(tmp_name);
+        return false;
+    }
+    return true;
+}
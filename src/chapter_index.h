@@ -0,0 +1,54 @@
+#pragma once
+
+#include "utils/vec.h"
+#include "utils/str.h"
+#include "utils/slice.h"
+
+// http only, the client can't do tls
+constexpr const char *chapter_url_fmt = "http://steel-ball-run.com/manga/jojos-bizarre-adventure-steel-ball-run-chapter-%d/";
+// redirects to the same host are followed, a redirect to https fails
+constexpr int max_chapter_redirects = 5;
+
+// finds the src of every <img> tag in an html page, the page can be fed in
+// pieces of any size as it arrives
+struct img_scanner {
+    using src_cb = void (*)(str_view src, void *udata);
+
+    img_scanner(src_cb callback, void *udata);
+    void feed(slice<const u8> data);
+
+private:
+    enum scan_state {
+        SCAN_TEXT,
+        SCAN_TAG_NAME,
+        SCAN_SKIP_TAG,
+        SCAN_ATTR_SPACE,
+        SCAN_ATTR_NAME,
+        SCAN_ATTR_AFTER_NAME,
+        SCAN_ATTR_BEFORE_VALUE,
+        SCAN_ATTR_VALUE,
+    };
+
+    void start_attr(char c);
+    void end_attr();
+    void end_tag();
+
+    src_cb on_src;
+    void *userdata;
+
+    scan_state state = SCAN_TEXT;
+    // only short names matter, longer ones are never "img" or "src"
+    char name[8] = {};
+    usize name_len = 0;
+    // quote character of the current value, 0 if unquoted
+    char quote = 0;
+    bool is_src = false;
+    bool has_src = false;
+    vec<char> value;
+    vec<char> src;
+};
+
+// downloads the chapter page and writes the url of every image in it to
+// filename, one per line. returns false and leaves filename alone if the
+// page couldn't be fetched
+bool fetch_chapter_index(int chapter, const char *filename);
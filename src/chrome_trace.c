@@ -0,0 +1,181 @@
+#include "chrome_trace.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <cthreads.h>
+
+#include "tracelog.h"
+
+#ifdef _WIN32
+    #pragma warning(disable:4996) // _CRT_SECURE_NO_WARNINGS.
+    #include <windows.h>
+    #define THREAD_LOCAL __declspec(thread)
+    // volatile accesses are acquire/release on x86 and x64
+    #define LOAD_ACQUIRE(p)     (*(volatile uint32_t *)(p))
+    #define STORE_RELEASE(p, v) (*(volatile uint32_t *)(p) = (v))
+    #define LOAD_PTR(p)         (*(void *volatile *)(p))
+#else
+    #include <time.h>
+    #define THREAD_LOCAL __thread
+    #define LOAD_ACQUIRE(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+    #define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+    #define LOAD_PTR(p)         __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#endif
+
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+} SpanEvent;
+
+typedef struct SpanThread {
+    SpanEvent events[SPAN_RING_SIZE];
+    // events ever written, only the last SPAN_RING_SIZE are kept
+    uint32_t head;
+    int id;
+    const char *name;
+    SpanEvent open[SPAN_MAX_DEPTH];
+    int depth;
+    struct SpanThread *next;
+} SpanThread;
+
+// every thread that ever recorded a span, they are never freed so the
+// spans of threads that are gone still end up in the dump
+static SpanThread *threads = NULL;
+static THREAD_LOCAL SpanThread *this_thread = NULL;
+static volatile bool enabled = true;
+
+static uint64_t nowUs(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq = {0};
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart * 1000000 + now.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#endif
+}
+
+static SpanThread *getThread(void) {
+    if (this_thread) return this_thread;
+
+    SpanThread *t = calloc(1, sizeof(SpanThread));
+    if (!t) return NULL;
+    t->id = thrCurrentId();
+
+    // pushed at the front, lock free since any thread can get here first
+#ifdef _WIN32
+    void *old = NULL;
+    do {
+        old = LOAD_PTR(&threads);
+        t->next = old;
+    } while (InterlockedCompareExchangePointer((void *volatile *)&threads, t, old) != old);
+#else
+    SpanThread *old = LOAD_PTR(&threads);
+    do {
+        t->next = old;
+    } while (!__atomic_compare_exchange_n(&threads, &old, t, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#endif
+
+    this_thread = t;
+    return t;
+}
+
+void spanBegin(const char *name) {
+    // a thread that never recorded anything doesn't need to start now,
+    // the others keep their depth right with an empty span
+    if (!enabled && !this_thread) return;
+    if (!enabled) name = NULL;
+    SpanThread *t = getThread();
+    if (!t) return;
+
+    // too deep, the span is dropped but spanEnd still has to match it
+    if (t->depth < SPAN_MAX_DEPTH) {
+        t->open[t->depth] = (SpanEvent){ .name = name, .start = nowUs() };
+    }
+    t->depth++;
+}
+
+void spanEnd(void) {
+    SpanThread *t = this_thread;
+    if (!t || t->depth == 0) return;
+
+    t->depth--;
+    if (t->depth >= SPAN_MAX_DEPTH) return;
+
+    SpanEvent ev = t->open[t->depth];
+    if (!ev.name) return;
+    ev.duration = nowUs() - ev.start;
+
+    uint32_t head = t->head;
+    t->events[head % SPAN_RING_SIZE] = ev;
+    STORE_RELEASE(&t->head, head + 1);
+}
+
+void spanThreadName(const char *name) {
+    SpanThread *t = getThread();
+    if (t) t->name = name;
+}
+
+void spanEnable(bool enable) {
+    enabled = enable;
+}
+
+static void writeName(FILE *fp, const char *name) {
+    fputc('"', fp);
+    for (const char *c = name; *c; ++c) {
+        if (*c == '"' || *c == '\\') fputc('\\', fp);
+        fputc(*c, fp);
+    }
+    fputc('"', fp);
+}
+
+bool spanDump(const char *filename) {
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) {
+        err("couldn't open %s", filename);
+        return false;
+    }
+
+    fputs("{\"traceEvents\":[\n", fp);
+    bool first = true;
+    size_t count = 0;
+
+    for (SpanThread *t = LOAD_PTR(&threads); t; t = t->next) {
+        if (t->name) {
+            fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",\n", t->id);
+            writeName(fp, t->name);
+            fputs("}}", fp);
+            first = false;
+        }
+
+        // the thread keeps writing while we read, the oldest events of a
+        // full ring could be getting overwritten so they are skipped
+        uint32_t head = LOAD_ACQUIRE(&t->head);
+        uint32_t from = 0;
+        if (head > SPAN_RING_SIZE) {
+            from = head - SPAN_RING_SIZE + SPAN_RING_SIZE / 8;
+        }
+
+        for (uint32_t i = from; i < head; ++i) {
+            SpanEvent ev = t->events[i % SPAN_RING_SIZE];
+            fprintf(fp, "%s{\"name\":", first ? "" : ",\n");
+            writeName(fp, ev.name);
+            fprintf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%llu}",
+                t->id, (unsigned long long)ev.start, (unsigned long long)ev.duration
+            );
+            first = false;
+            count++;
+        }
+    }
+
+    fputs("\n]}\n", fp);
+    fclose(fp);
+    info("wrote %zu spans to %s", count, filename);
+    return true;
+}
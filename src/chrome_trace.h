@@ -0,0 +1,42 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+/* Spans are recorded in a ring buffer per thread, so the last few thousand
+ * of every thread are always there. spanDump writes them out in the
+ * chrome://tracing json format, which Perfetto can open too.
+ * -> names must be string literals (or live as long as the program)
+ * -> spans must be ended on the thread that began them, in reverse order
+*/
+
+enum {
+    SPAN_RING_SIZE = 8192,
+    SPAN_MAX_DEPTH = 32,
+};
+
+void spanBegin(const char *name);
+void spanEnd(void);
+// shown instead of the thread id
+void spanThreadName(const char *name);
+// turns the recording on and off, it starts on
+void spanEnable(bool enabled);
+// spans still open aren't written, returns false if the file can't be opened
+bool spanDump(const char *filename);
+
+#ifdef __cplusplus
+} // extern "C"
+
+struct ScopedSpan {
+    ScopedSpan(const char *name) { spanBegin(name); }
+    ~ScopedSpan() { spanEnd(); }
+};
+
+#define SPAN_CONCAT2(a, b) a##b
+#define SPAN_CONCAT(a, b) SPAN_CONCAT2(a, b)
+// records a span until the end of the scope
+#define SPAN(name) ScopedSpan SPAN_CONCAT(span_, __LINE__)(name)
+#endif
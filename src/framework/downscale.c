@@ -0,0 +1,109 @@
+#include "downscale.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define DOWNSCALE_SSE2 1
+    #include <emmintrin.h>
+#else
+    #define DOWNSCALE_SSE2 0
+#endif
+
+int mipSize(int size, int level) {
+    size >>= level;
+    return size > 0 ? size : 1;
+}
+
+int mipCount(int width, int height) {
+    int largest = width > height ? width : height;
+    int count = 1;
+    while (largest > 1) {
+        largest >>= 1;
+        ++count;
+    }
+    return count;
+}
+
+static uchar avg4(uchar a, uchar b, uchar c, uchar d) {
+    return (uchar)((a + b + c + d + 2) >> 2);
+}
+
+// scalar version, also used for the pixels left over by the simd loops and
+// for 1 pixel wide/tall images, where the same row/column is used twice
+static void downscaleRow(const uchar *a, const uchar *b, int width, int from, int to, int channels, uchar *dst) {
+    for (int x = from; x < to; ++x) {
+        int x0 = x * 2;
+        int x1 = x0 + 1 < width ? x0 + 1 : x0;
+        for (int c = 0; c < channels; ++c) {
+            dst[x * channels + c] = avg4(
+                a[x0 * channels + c], a[x1 * channels + c],
+                b[x0 * channels + c], b[x1 * channels + c]
+            );
+        }
+    }
+}
+
+#if DOWNSCALE_SSE2
+// 8 pixels in, 4 out. averaging the rows first and then the columns rounds
+// up twice, which is at most 1 off from the scalar version
+static int downscaleRowRGBA(const uchar *a, const uchar *b, int out_width, uchar *dst) {
+    int x = 0;
+    for (; x + 4 <= out_width; x += 4) {
+        __m128i lo = _mm_avg_epu8(
+            _mm_loadu_si128((const __m128i *)(a + x * 8)),
+            _mm_loadu_si128((const __m128i *)(b + x * 8))
+        );
+        __m128i hi = _mm_avg_epu8(
+            _mm_loadu_si128((const __m128i *)(a + x * 8 + 16)),
+            _mm_loadu_si128((const __m128i *)(b + x * 8 + 16))
+        );
+        __m128 lo_ps = _mm_castsi128_ps(lo);
+        __m128 hi_ps = _mm_castsi128_ps(hi);
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(lo_ps, hi_ps, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd = _mm_castps_si128(_mm_shuffle_ps(lo_ps, hi_ps, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_avg_epu8(even, odd));
+    }
+    return x;
+}
+
+// 32 pixels in, 16 out
+static int downscaleRowGrey(const uchar *a, const uchar *b, int out_width, uchar *dst) {
+    const __m128i mask = _mm_set1_epi16(0xff);
+    int x = 0;
+    for (; x + 16 <= out_width; x += 16) {
+        __m128i lo = _mm_avg_epu8(
+            _mm_loadu_si128((const __m128i *)(a + x * 2)),
+            _mm_loadu_si128((const __m128i *)(b + x * 2))
+        );
+        __m128i hi = _mm_avg_epu8(
+            _mm_loadu_si128((const __m128i *)(a + x * 2 + 16)),
+            _mm_loadu_si128((const __m128i *)(b + x * 2 + 16))
+        );
+        __m128i lo_avg = _mm_avg_epu16(_mm_and_si128(lo, mask), _mm_srli_epi16(lo, 8));
+        __m128i hi_avg = _mm_avg_epu16(_mm_and_si128(hi, mask), _mm_srli_epi16(hi, 8));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_packus_epi16(lo_avg, hi_avg));
+    }
+    return x;
+}
+#endif
+
+void downscaleHalf(const uchar *src, int width, int height, int stride, int channels, uchar *dst, int dst_stride) {
+    int out_width = mipSize(width, 1);
+    int out_height = mipSize(height, 1);
+
+    for (int y = 0; y < out_height; ++y) {
+        const uchar *a = src + (size_t)(y * 2) * stride;
+        const uchar *b = y * 2 + 1 < height ? a + stride : a;
+        uchar *out = dst + (size_t)y * dst_stride;
+
+        int done = 0;
+#if DOWNSCALE_SSE2
+        // the simd loops read 2 pixels for every one they write, which only
+        // holds when the row isn't clamped
+        if (width > 1) {
+            done = channels == 4 ? 
+                downscaleRowRGBA(a, b, out_width, out) :
+                downscaleRowGrey(a, b, out_width, out);
+        }
+#endif
+        downscaleRow(a, b, width, done, out_width, channels, out);
+    }
+}
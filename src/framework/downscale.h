@@ -0,0 +1,13 @@
+#pragma once
+
+#include "framework.h"
+
+// size of a side at the given mip level, never less than 1
+int mipSize(int size, int level);
+// number of levels down to 1x1, full size one included
+int mipCount(int width, int height);
+
+// 2x2 box filter, dst is mipSize(width, 1) x mipSize(height, 1) with rows
+// dst_stride bytes apart. channels is 1 or 4, strides are in bytes.
+// odd sizes drop the last row/column, like every gpu does for its mips
+void downscaleHalf(const uchar *src, int width, int height, int stride, int channels, uchar *dst, int dst_stride);
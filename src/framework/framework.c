@@ -3,6 +3,16 @@
 // stdlib
 #include <math.h>
 #include <assert.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <win32_slim.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 // sokol
 #include <sokol_app.h>
@@ -13,8 +23,14 @@
 // stb
 #include <stb_image.h>
 
+// colla
+#include <cthreads.h>
+
 #include "../tracelog.h"
+#include "../chrome_trace.h"
 #include "base.glsl.h"
+#include "texcompress.h"
+#include "downscale.h"
 
 #define COLOUR_TO_NORM(c) { (c).r/255.f, (c).g/255.f, (c).b/255.f, (c).a/255.f }
 
@@ -24,7 +40,20 @@ enum {
     BATCH_SIZE = 512,
     // for most of our use (quads) we'll need 4 vertices and 6 indices
     MAX_VERTICES = BATCH_SIZE * 4,
-    MAX_INDICES = BATCH_SIZE * 6
+    MAX_INDICES = BATCH_SIZE * 6,
+    MAX_DECODE_WORKERS = 32,
+    // images that can wait for a free decode worker, per worker
+    DECODE_QUEUE_PER_WORKER = 2,
+    // quads drawn with drawTextureImmediate in a frame
+    MAX_IMMEDIATE_QUADS = 64,
+    // images bigger than this on either side are split in tiles, even if the
+    // gpu could take them, so a single upload never gets too big
+    MAX_UNTILED_SIZE = 4096,
+    // must be a power of 2, so the tiles line up with the mip levels
+    TEXTURE_TILE_SIZE = 2048,
+    // how far apart the channels of a pixel can be for it to still count as
+    // grey, scans saved as colour jpegs are never exactly grey
+    GREY_TOLERANCE = 6,
 };
 
 typedef struct {
@@ -53,10 +82,46 @@ static struct {
     sg_pipeline pip;
     sg_bindings bind;
     sg_pass_action pass_action;
+    // drawTextureImmediate appends to its own buffer, as the batch one is
+    // updated once per frame
+    sg_buffer imm_vbuf;
+    sg_buffer imm_ibuf;
     uint64_t last_time;
     uint64_t dt;
+    bool bc1_supported;
+    bool bc4_supported;
 } state = {0};
 
+typedef struct {
+    const uchar *data;
+    uint len;
+    ImageLoadedCb callback;
+    ImageCancelCb cancelled;
+    void *udata;
+    uint64_t queued_at;
+} DecodeJob;
+
+static struct {
+    cthread_t threads[MAX_DECODE_WORKERS];
+    int worker_count;
+    cmutex_t mtx;
+    ccondvar_t not_empty;
+    ccondvar_t not_full;
+    // ring buffer of pending jobs
+    DecodeJob *jobs;
+    int cap;
+    int head;
+    int len;
+    bool stopping;
+    // set by setImageCompression and setGreyscaleDetection, read by the workers
+    volatile bool compress;
+    volatile bool detect_grey;
+    volatile bool mipmaps;
+    uint64_t done;
+    uint64_t wait_ticks;
+    uint64_t decode_ticks;
+} decode_pool = {0};
+
 // checks if the batch needs to redraw
 static bool batchCheckTexture(Texture tex);
 static bool batchCheckMatrix(matrix mat);
@@ -73,6 +138,9 @@ static void batchPushQuad(Rect rect, Rect uv, Colour tint);
 void initFramework(void) {
     sg_setup(&(sg_desc){ .context = sapp_sgcontext()});
     stm_setup();
+    state.bc1_supported = sg_query_pixelformat(SG_PIXELFORMAT_BC1_RGBA).sample;
+    state.bc4_supported = sg_query_pixelformat(SG_PIXELFORMAT_BC4_R).sample;
+    initDecodePool(0);
     //stbi_set_flip_vertically_on_load(true);
 
     options.res_w = 200;
@@ -98,6 +166,17 @@ void initFramework(void) {
         .usage = SG_USAGE_STREAM
     });
 
+    state.imm_vbuf = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(Vertex) * 4 * MAX_IMMEDIATE_QUADS,
+        .usage = SG_USAGE_STREAM
+    });
+
+    u16 quad_indices[6] = { 0, 1, 2, 2, 3, 0 };
+    state.imm_ibuf = sg_make_buffer(&(sg_buffer_desc){
+        .type = SG_BUFFERTYPE_INDEXBUFFER,
+        .data = SG_RANGE(quad_indices),
+    });
+
     uint32_t pixels[2*2] = {
         0xFF000000, 0xFF000000,
         0xFF000000, 0xFF000000,
@@ -125,6 +204,7 @@ void initFramework(void) {
 }
 
 void cleanupFramework(void) {
+    cleanupDecodePool();
     sg_shutdown();
 }
 
@@ -229,26 +309,563 @@ void freeAnimSprite(AnimSprite sprite) {
 }
 
 Image loadImage(const char *filename) {
-    Image out;
+    Image out = {0};
     int channels;
     out.data = stbi_load(filename, &out.width, &out.height, &channels, 4);
     assert(out.data != NULL);
     return out;
 }
 
-Image loadImageFromMemory(const uchar *data, uint len) {
-    Image out;
+static bool isGreyscale(Image image) {
+    size_t count = (size_t)image.width * image.height;
+    for (size_t i = 0; i < count; ++i) {
+        const uchar *p = image.data + i * 4;
+        int lo = p[0], hi = p[0];
+        if (p[1] < lo) lo = p[1];
+        if (p[1] > hi) hi = p[1];
+        if (p[2] < lo) lo = p[2];
+        if (p[2] > hi) hi = p[2];
+        // colour pages usually bail out in the first few rows
+        if (hi - lo > GREY_TOLERANCE) return false;
+    }
+    return true;
+}
+
+static size_t imageStride(int width, ImageFormat format);
+
+// keeps the green channel, which is the one closest to the luminance, and
+// drops alpha as pages are opaque. the buffer is packed in place and keeps
+// its size, it's short lived anyway. the padded rows never get ahead of
+// the pixels they're read from
+static Image toGreyscale(Image image) {
+    size_t stride = imageStride(image.width, IMAGE_R8);
+    for (int y = 0; y < image.height; ++y) {
+        const uchar *src = image.data + (size_t)y * image.width * 4;
+        uchar *dst = image.data + y * stride;
+        for (int x = 0; x < image.width; ++x) {
+            dst[x] = src[x * 4 + 1];
+        }
+    }
+    image.format = IMAGE_R8;
+    return image;
+}
+
+// stbi packs greyscale rows tightly, they're moved apart from the bottom
+// up to imageStride
+static Image padGreyRows(Image image) {
+    size_t stride = imageStride(image.width, IMAGE_R8);
+    if (stride == (size_t)image.width) return image;
+
+    uchar *data = realloc(image.data, stride * image.height);
+    if (!data) {
+        stbi_image_free(image.data);
+        return (Image){0};
+    }
+    for (int y = image.height; y-- > 1;) {
+        memmove(data + y * stride, data + (size_t)y * image.width, (size_t)image.width);
+    }
+    image.data = data;
+    return image;
+}
+
+static Image decodeImage(const uchar *data, uint len, bool detect_grey) {
+    spanBegin("stbi decode");
+    Image out = {0};
     int channels;
-    out.data = stbi_load_from_memory(data, len, &out.width, &out.height, &channels, 4);
+    if (detect_grey && 
+        stbi_info_from_memory(data, len, &out.width, &out.height, &channels) && 
+        channels <= 2
+    ) {
+        out.data = stbi_load_from_memory(data, len, &out.width, &out.height, &channels, 1);
+        out.format = IMAGE_R8;
+        if (out.data) {
+            out = padGreyRows(out);
+        }
+    }
+    else {
+        out.data = stbi_load_from_memory(data, len, &out.width, &out.height, &channels, 4);
+        if (out.data && detect_grey && isGreyscale(out)) {
+            out = toGreyscale(out);
+        }
+    }
     if (out.data == NULL) {
         err("stbi error: %s", stbi_failure_reason());
     }
+    spanEnd();
+    return out;
+}
+
+Image loadImageFromMemory(const uchar *data, uint len) {
+    Image out = decodeImage(data, len, false);
     assert(out.data != NULL);
     return out;
 }
 
+static bool isBlockCompressed(ImageFormat format) {
+    return format == IMAGE_BC1 || format == IMAGE_BC4;
+}
+
+static void unmapFile(void *mapping, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, size);
+#endif
+}
+
 void freeImage(Image image) {
-    stbi_image_free(image.data);
+    if (image.mapping) {
+        unmapFile(image.mapping, sizeof(RawImageHeader) + imageDataSize(image));
+    }
+    else if (isBlockCompressed(image.format)) {
+        free(image.data);
+    }
+    else {
+        stbi_image_free(image.data);
+    }
+}
+
+// bytes in a row of pixels, or in a row of blocks for compressed formats.
+// greyscale rows are padded to 4 bytes on every level: sokol never sets
+// GL_UNPACK_ALIGNMENT, so GL reads them with its default of 4
+static size_t imageStride(int width, ImageFormat format) {
+    switch (format) {
+    case IMAGE_BC1: 
+    case IMAGE_BC4: return (size_t)(width + 3) / 4 * 8;
+    case IMAGE_R8:  return ((size_t)width + 3) & ~(size_t)3;
+    default:        return (size_t)width * 4;
+    }
+}
+
+static size_t imageRows(int height, ImageFormat format) {
+    return isBlockCompressed(format) ? (size_t)(height + 3) / 4 : (size_t)height;
+}
+
+static int imageMipmaps(Image image) {
+    return image.mipmaps > 1 ? image.mipmaps : 1;
+}
+
+static size_t levelSize(int width, int height, ImageFormat format, int level) {
+    return imageStride(mipSize(width, level), format) * imageRows(mipSize(height, level), format);
+}
+
+static size_t chainSize(int width, int height, ImageFormat format, int mipmaps) {
+    size_t size = 0;
+    for (int i = 0; i < mipmaps; ++i) {
+        size += levelSize(width, height, format, i);
+    }
+    return size;
+}
+
+size_t imageDataSize(Image image) {
+    return chainSize(image.width, image.height, image.format, imageMipmaps(image));
+}
+
+static int formatChannels(ImageFormat format) {
+    return format == IMAGE_R8 ? 1 : 4;
+}
+
+// D3D11 wants the size of compressed textures to be a multiple of 4, pages
+// can lose up to 3 pixels on the right and bottom edges. the rows are moved
+// in place, the image must not have mips yet
+static Image cropToBlocks(Image image) {
+    int width = image.width & ~3;
+    int height = image.height & ~3;
+    if (width == 0 || height == 0) return image;
+
+    if (width != image.width) {
+        size_t src_stride = imageStride(image.width, image.format);
+        size_t dst_stride = imageStride(width, image.format);
+        for (int y = 1; y < height; ++y) {
+            memmove(image.data + y * dst_stride, image.data + y * src_stride, dst_stride);
+        }
+    }
+    image.width = width;
+    image.height = height;
+    return image;
+}
+
+// runs on the decode workers, the levels are appended to the same buffer.
+// stbi allocates with malloc, so it can be grown with realloc
+static Image buildMipmaps(Image image) {
+    int count = mipCount(image.width, image.height);
+    if (count > SG_MAX_MIPMAPS) count = SG_MAX_MIPMAPS;
+    if (count <= 1) return image;
+
+    uchar *data = realloc(image.data, chainSize(image.width, image.height, image.format, count));
+    if (!data) return image;
+    image.data = data;
+
+    int channels = formatChannels(image.format);
+    uchar *level = image.data;
+    for (int i = 1; i < count; ++i) {
+        int width = mipSize(image.width, i - 1);
+        int height = mipSize(image.height, i - 1);
+        uchar *next = level + levelSize(image.width, image.height, image.format, i - 1);
+        downscaleHalf(
+            level, width, height, (int)imageStride(width, image.format), channels,
+            next, (int)imageStride(mipSize(width, 1), image.format)
+        );
+        level = next;
+    }
+    image.mipmaps = count;
+    return image;
+}
+
+static bool canCompress(Image image) {
+    bool grey = image.format == IMAGE_R8;
+    return 
+        (grey ? state.bc4_supported : state.bc1_supported) &&
+        (image.width & 3) == 0 && (image.height & 3) == 0;
+}
+
+// runs on the decode workers, the image is freed if it gets compressed.
+// rgba images become BC1 and greyscale ones BC4, every mip level included.
+// the size must already be a multiple of 4 (see cropToBlocks)
+static Image compressImage(Image image) {
+    if (!canCompress(image)) return image;
+
+    bool grey = image.format == IMAGE_R8;
+    Image out = {
+        .width = image.width,
+        .height = image.height,
+        .format = grey ? IMAGE_BC4 : IMAGE_BC1,
+        .mipmaps = image.mipmaps,
+    };
+    out.data = malloc(imageDataSize(out));
+    if (!out.data) return image;
+
+    const uchar *src = image.data;
+    uchar *dst = out.data;
+    for (int i = 0; i < imageMipmaps(image); ++i) {
+        int width = mipSize(image.width, i);
+        int height = mipSize(image.height, i);
+        if (grey) {
+            compressBC4(src, width, height, (int)imageStride(width, IMAGE_R8), dst);
+        }
+        else {
+            compressBC1(src, width, height, width * 4, dst);
+        }
+        src += levelSize(image.width, image.height, image.format, i);
+        dst += levelSize(out.width, out.height, out.format, i);
+    }
+    freeImage(image);
+    return out;
+}
+
+void setImageCompression(bool enabled) {
+    decode_pool.compress = enabled && state.bc1_supported;
+    if (enabled && !state.bc1_supported) {
+        warn("BC1 textures aren't supported, images won't be compressed");
+    }
+}
+
+void setGreyscaleDetection(bool enabled) {
+    decode_pool.detect_grey = enabled;
+}
+
+void setImageMipmaps(bool enabled) {
+    decode_pool.mipmaps = enabled;
+}
+
+// the level as 4 bytes per pixel, whatever its format
+static void levelToRGBA(Image image, int level, uchar *out) {
+    const uchar *src = image.data;
+    for (int i = 0; i < level; ++i) {
+        src += levelSize(image.width, image.height, image.format, i);
+    }
+    int width = mipSize(image.width, level);
+    int height = mipSize(image.height, level);
+    size_t count = (size_t)width * height;
+
+    switch (image.format) {
+    case IMAGE_RGBA8:
+        memcpy(out, src, count * 4);
+        break;
+    case IMAGE_BC1:
+        decompressBC1(src, width, height, out);
+        break;
+    case IMAGE_R8:
+    case IMAGE_BC4:
+    {
+        size_t stride = imageStride(width, IMAGE_R8);
+        if (image.format == IMAGE_BC4) {
+            // decoded at the start of the buffer, then spread backwards
+            decompressBC4(src, width, height, out);
+            src = out;
+            stride = (size_t)width;
+        }
+        for (size_t i = count; i-- > 0;) {
+            uchar v = src[i / width * stride + i % width];
+            out[i * 4 + 0] = v;
+            out[i * 4 + 1] = v;
+            out[i * 4 + 2] = v;
+            out[i * 4 + 3] = 255;
+        }
+        break;
+    }
+    }
+}
+
+Image makeThumbnail(Image image, int max_height) {
+    // the smallest level that's still tall enough
+    int level = 0;
+    while (level + 1 < imageMipmaps(image) && mipSize(image.height, level + 1) >= max_height) {
+        ++level;
+    }
+
+    Image out = {
+        .width = mipSize(image.width, level),
+        .height = mipSize(image.height, level),
+        .format = IMAGE_RGBA8,
+    };
+    out.data = malloc((size_t)out.width * out.height * 4);
+    if (!out.data) return (Image){0};
+    levelToRGBA(image, level, out.data);
+
+    while (out.height > max_height) {
+        int width = mipSize(out.width, 1);
+        int height = mipSize(out.height, 1);
+        uchar *half = malloc((size_t)width * height * 4);
+        if (!half) break;
+        downscaleHalf(out.data, out.width, out.height, out.width * 4, 4, half, width * 4);
+        free(out.data);
+        out.data = half;
+        out.width = width;
+        out.height = height;
+    }
+    return out;
+}
+
+RawImageHeader rawImageHeader(Image image) {
+    RawImageHeader header = {
+        .width = (u32)image.width,
+        .height = (u32)image.height,
+        .stride = (u32)imageStride(image.width, image.format),
+        .format = (u32)image.format,
+        .mipmaps = (u32)imageMipmaps(image),
+    };
+    memcpy(header.magic, RAW_IMAGE_MAGIC, sizeof(header.magic));
+    return header;
+}
+
+Image mapRawImage(const char *filename) {
+    Image out = {0};
+    uchar *mapping = NULL;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return out;
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart >= (LONGLONG)sizeof(RawImageHeader)) {
+        size = (size_t)file_size.QuadPart;
+        HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map) {
+            mapping = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+            // the view keeps the file alive
+            CloseHandle(map);
+        }
+    }
+    CloseHandle(file);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return out;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(RawImageHeader)) {
+        size = (size_t)st.st_size;
+        mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) mapping = NULL;
+    }
+    close(fd);
+#endif
+
+    if (!mapping) return out;
+
+    RawImageHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    ImageFormat format = (ImageFormat)header.format;
+    bool valid =
+        memcmp(header.magic, RAW_IMAGE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.format <= IMAGE_BC4 &&
+        header.mipmaps <= SG_MAX_MIPMAPS &&
+        header.stride == imageStride((int)header.width, format) &&
+        size == sizeof(RawImageHeader) + chainSize((int)header.width, (int)header.height, format, header.mipmaps ? (int)header.mipmaps : 1);
+
+    if (!valid) {
+        err("%s is not a valid raw image", filename);
+        unmapFile(mapping, size);
+        return out;
+    }
+
+    out.data = mapping + sizeof(RawImageHeader);
+    out.width = (int)header.width;
+    out.height = (int)header.height;
+    out.format = format;
+    out.mipmaps = (int)header.mipmaps;
+    out.mapping = mapping;
+    return out;
+}
+
+static bool jobCancelled(const DecodeJob *job) {
+    return job->cancelled && job->cancelled(job->udata);
+}
+
+static Image dropIfCancelled(Image img, const DecodeJob *job) {
+    if (img.data && jobCancelled(job)) {
+        freeImage(img);
+        return (Image){0};
+    }
+    return img;
+}
+
+static int decodeWorker(void *udata) {
+    (void)udata;
+    spanThreadName("decode worker");
+
+    while (true) {
+        mtxLock(decode_pool.mtx);
+        while (!decode_pool.stopping && decode_pool.len == 0) {
+            condWait(decode_pool.not_empty, decode_pool.mtx);
+        }
+        // the queue is drained before stopping, so every job gets its callback
+        if (decode_pool.len == 0) {
+            mtxUnlock(decode_pool.mtx);
+            return 0;
+        }
+        DecodeJob job = decode_pool.jobs[decode_pool.head];
+        decode_pool.head = (decode_pool.head + 1) % decode_pool.cap;
+        decode_pool.len--;
+        mtxUnlock(decode_pool.mtx);
+        condWakeOne(decode_pool.not_full);
+
+        // stale jobs are dropped as soon as possible, a single step can't be stopped
+        spanBegin("decode page");
+        uint64_t start = stm_now();
+        Image img = {0};
+        if (!jobCancelled(&job)) {
+            img = decodeImage(job.data, job.len, decode_pool.detect_grey);
+        }
+        if (img.data && decode_pool.compress) {
+            img = cropToBlocks(img);
+        }
+        img = dropIfCancelled(img, &job);
+        if (img.data && decode_pool.mipmaps) {
+            img = buildMipmaps(img);
+        }
+        img = dropIfCancelled(img, &job);
+        if (img.data && decode_pool.compress) {
+            img = compressImage(img);
+        }
+        uint64_t end = stm_now();
+        spanEnd();
+
+        mtxLock(decode_pool.mtx);
+        decode_pool.done++;
+        decode_pool.wait_ticks += stm_diff(start, job.queued_at);
+        decode_pool.decode_ticks += stm_diff(end, start);
+        mtxUnlock(decode_pool.mtx);
+
+        job.callback(img, job.udata);
+    }
+}
+
+void initDecodePool(int workers) {
+    if (decode_pool.worker_count > 0) return;
+
+    stm_setup();
+
+    if (workers <= 0) workers = thrCpuCount();
+    if (workers > MAX_DECODE_WORKERS) workers = MAX_DECODE_WORKERS;
+
+    decode_pool.mtx = mtxInit();
+    decode_pool.not_empty = condInit();
+    decode_pool.not_full = condInit();
+    decode_pool.cap = workers * DECODE_QUEUE_PER_WORKER;
+    decode_pool.jobs = malloc(sizeof(DecodeJob) * decode_pool.cap);
+    decode_pool.head = 0;
+    decode_pool.len = 0;
+    decode_pool.stopping = false;
+
+    for (int i = 0; i < workers; ++i) {
+        decode_pool.threads[i] = thrCreate(decodeWorker, NULL);
+        if (!thrValid(decode_pool.threads[i])) {
+            err("couldn't start decode worker %d", i);
+            break;
+        }
+        decode_pool.worker_count++;
+    }
+
+    info("started %d decode workers", decode_pool.worker_count);
+}
+
+void cleanupDecodePool(void) {
+    if (decode_pool.worker_count == 0) return;
+
+    mtxLock(decode_pool.mtx);
+    decode_pool.stopping = true;
+    mtxUnlock(decode_pool.mtx);
+    condWakeAll(decode_pool.not_empty);
+    condWakeAll(decode_pool.not_full);
+
+    for (int i = 0; i < decode_pool.worker_count; ++i) {
+        thrJoin(decode_pool.threads[i], NULL);
+    }
+    decode_pool.worker_count = 0;
+
+    condDestroy(decode_pool.not_full);
+    condDestroy(decode_pool.not_empty);
+    mtxDestroy(decode_pool.mtx);
+    free(decode_pool.jobs);
+    decode_pool.jobs = NULL;
+}
+
+void loadImageFromMemoryAsync(const uchar *data, uint len, ImageLoadedCb callback, void *udata) {
+    loadImageFromMemoryAsyncEx(data, len, callback, NULL, udata);
+}
+
+void loadImageFromMemoryAsyncEx(const uchar *data, uint len, ImageLoadedCb callback, ImageCancelCb cancelled, void *udata) {
+    assert(decode_pool.worker_count > 0);
+
+    mtxLock(decode_pool.mtx);
+    while (!decode_pool.stopping && decode_pool.len == decode_pool.cap) {
+        condWait(decode_pool.not_full, decode_pool.mtx);
+    }
+    if (decode_pool.stopping) {
+        mtxUnlock(decode_pool.mtx);
+        callback((Image){0}, udata);
+        return;
+    }
+    int index = (decode_pool.head + decode_pool.len) % decode_pool.cap;
+    decode_pool.jobs[index] = (DecodeJob){
+        .data = data,
+        .len = len,
+        .callback = callback,
+        .cancelled = cancelled,
+        .udata = udata,
+        .queued_at = stm_now(),
+    };
+    decode_pool.len++;
+    mtxUnlock(decode_pool.mtx);
+    condWakeOne(decode_pool.not_empty);
+}
+
+DecodeStats decodeStats(void) {
+    DecodeStats out = {0};
+    if (decode_pool.worker_count == 0) return out;
+
+    mtxLock(decode_pool.mtx);
+    out.workers = decode_pool.worker_count;
+    out.queued = decode_pool.len;
+    out.capacity = decode_pool.cap;
+    out.done = decode_pool.done;
+    if (decode_pool.done > 0) {
+        out.avg_wait_ms = stm_ms(decode_pool.wait_ticks) / (double)decode_pool.done;
+        out.avg_decode_ms = stm_ms(decode_pool.decode_ticks) / (double)decode_pool.done;
+    }
+    mtxUnlock(decode_pool.mtx);
+    return out;
 }
 
 Texture loadTexture(const char *filename) {
@@ -258,20 +875,209 @@ Texture loadTexture(const char *filename) {
     return tex;
 }
 
-Texture loadTextureFromImage(Image image) {
-    sg_image tex = sg_make_image(&(sg_image_desc){
+static Texture createTexture(Image image, sg_wrap wrap) {
+    static const sg_pixel_format formats[] = {
+        [IMAGE_RGBA8] = SG_PIXELFORMAT_RGBA8,
+        [IMAGE_BC1]   = SG_PIXELFORMAT_BC1_RGBA,
+        [IMAGE_R8]    = SG_PIXELFORMAT_R8,
+        [IMAGE_BC4]   = SG_PIXELFORMAT_BC4_R,
+    };
+    sg_image_desc desc = {
         .width = image.width,
         .height = image.height,
-        .data.subimage[0][0] = { image.data, image.width * image.height * 4 }
-    });
+        .num_mipmaps = imageMipmaps(image),
+        .pixel_format = formats[image.format],
+        .wrap_u = wrap,
+        .wrap_v = wrap,
+    };
+    if (desc.num_mipmaps > 1) {
+        desc.min_filter = SG_FILTER_LINEAR_MIPMAP_LINEAR;
+        desc.mag_filter = SG_FILTER_LINEAR;
+    }
+
+    const uchar *level = image.data;
+    for (int i = 0; i < desc.num_mipmaps; ++i) {
+        size_t size = levelSize(image.width, image.height, image.format, i);
+        desc.data.subimage[0][i] = (sg_range){ level, size };
+        level += size;
+    }
+
+    spanBegin("sg_make_image");
+    sg_image tex = sg_make_image(&desc);
+    spanEnd();
     assert(tex.id != 0);
-    return (Texture){ tex.id };
+    return (Texture){ 
+        .id = tex.id, 
+        .grey = image.format == IMAGE_R8 || image.format == IMAGE_BC4,
+    };
+}
+
+Texture loadTextureFromImage(Image image) {
+    return createTexture(image, _SG_WRAP_DEFAULT);
 }
 
 void freeTexture(Texture texture) {
     sg_destroy_image((sg_image){texture.id});
 }
 
+Texture makeDynamicTexture(int width, int height) {
+    sg_image tex = sg_make_image(&(sg_image_desc){
+        .width = width,
+        .height = height,
+        .usage = SG_USAGE_DYNAMIC,
+        .min_filter = SG_FILTER_LINEAR,
+        .mag_filter = SG_FILTER_LINEAR,
+        .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+    });
+    assert(tex.id != 0);
+    return (Texture){ .id = tex.id };
+}
+
+void updateDynamicTexture(Texture texture, const uchar *rgba, size_t size) {
+    sg_update_image((sg_image){ texture.id }, &(sg_image_data){
+        .subimage[0][0] = { rgba, size },
+    });
+}
+
+static int maxTextureSize(void) {
+    int size = sg_query_limits().max_image_size_2d;
+    // the dummy backend doesn't report any
+    return size > 0 ? size : 16384;
+}
+
+TiledTexture makeTiledTexture(Image image) {
+    TiledTexture out = {
+        .cols = 1,
+        .rows = 1,
+        .tile_width = image.width,
+        .tile_height = image.height,
+        .width = image.width,
+        .height = image.height,
+    };
+
+    int max_size = maxTextureSize();
+    int untiled = max_size < MAX_UNTILED_SIZE ? max_size : MAX_UNTILED_SIZE;
+    if (image.width > untiled || image.height > untiled) {
+        int tile = TEXTURE_TILE_SIZE;
+        while (tile > max_size) tile /= 2;
+        out.tile_width = image.width < tile ? image.width : tile;
+        out.tile_height = image.height < tile ? image.height : tile;
+        out.cols = (image.width + tile - 1) / tile;
+        out.rows = (image.height + tile - 1) / tile;
+    }
+
+    out.tiles = calloc((size_t)(out.cols * out.rows), sizeof(Texture));
+    return out;
+}
+
+Rect tiledTextureTileRect(TiledTexture texture, int col, int row) {
+    Rect rect = {
+        .x = (float)(col * texture.tile_width),
+        .y = (float)(row * texture.tile_height),
+        .w = (float)texture.tile_width,
+        .h = (float)texture.tile_height,
+    };
+    if (rect.x + rect.w > texture.width)  rect.w = texture.width - rect.x;
+    if (rect.y + rect.h > texture.height) rect.h = texture.height - rect.y;
+    return rect;
+}
+
+Texture tiledTextureTile(TiledTexture texture, int col, int row) {
+    return texture.tiles[col + row * texture.cols];
+}
+
+// copies a level of the tile out of the same level of the image, in units
+// of pixels or 4x4 blocks. the units past the edge of the image repeat the
+// last row/column. past the point where the tile doesn't start on a block
+// anymore (a few pixels wide levels) it takes the closest block instead
+static void copyTileLevel(Image image, int level, int x, int y, int width, int height, uchar *dst) {
+    bool blocks = isBlockCompressed(image.format);
+    int unit = blocks ? 4 : 1;
+    size_t unit_bytes = blocks ? 8 : (size_t)formatChannels(image.format);
+
+    const uchar *src = image.data;
+    for (int i = 0; i < level; ++i) {
+        src += levelSize(image.width, image.height, image.format, i);
+    }
+    size_t stride = imageStride(mipSize(image.width, level), image.format);
+    size_t dst_stride = imageStride(width, image.format);
+    int src_cols = (mipSize(image.width, level) + unit - 1) / unit;
+    int src_rows = (mipSize(image.height, level) + unit - 1) / unit;
+
+    int col0 = x / unit;
+    int row0 = y / unit;
+    int cols = (width + unit - 1) / unit;
+    int rows = (height + unit - 1) / unit;
+    if (col0 >= src_cols) col0 = src_cols - 1;
+    if (row0 >= src_rows) row0 = src_rows - 1;
+    int copied = src_cols - col0 < cols ? src_cols - col0 : cols;
+
+    for (int r = 0; r < rows; ++r) {
+        int src_row = row0 + r < src_rows ? row0 + r : src_rows - 1;
+        const uchar *from = src + src_row * stride + col0 * unit_bytes;
+        uchar *to = dst + r * dst_stride;
+        memcpy(to, from, copied * unit_bytes);
+        for (int c = copied; c < cols; ++c) {
+            memcpy(to + c * unit_bytes, from + (copied - 1) * unit_bytes, unit_bytes);
+        }
+    }
+}
+
+static Texture uploadTile(TiledTexture *texture, Image image, int index) {
+    int col = index % texture->cols;
+    int row = index / texture->cols;
+    Rect rect = tiledTextureTileRect(*texture, col, row);
+    int width = (int)rect.w;
+    int height = (int)rect.h;
+    int x = (int)rect.x;
+    int y = (int)rect.y;
+
+    int mipmaps = mipCount(width, height);
+    if (mipmaps > imageMipmaps(image)) mipmaps = imageMipmaps(image);
+
+    Image tile = {
+        .width = width,
+        .height = height,
+        .format = image.format,
+        .mipmaps = mipmaps,
+    };
+    tile.data = malloc(imageDataSize(tile));
+    if (!tile.data) return (Texture){0};
+
+    uchar *level = tile.data;
+    for (int i = 0; i < mipmaps; ++i) {
+        copyTileLevel(image, i, x >> i, y >> i, mipSize(width, i), mipSize(height, i), level);
+        level += levelSize(width, height, image.format, i);
+    }
+
+    Texture out = createTexture(tile, SG_WRAP_CLAMP_TO_EDGE);
+    free(tile.data);
+    return out;
+}
+
+bool uploadTextureTiles(TiledTexture *texture, Image image, int count) {
+    int total = texture->cols * texture->rows;
+    for (; count > 0 && texture->uploaded < total; --count) {
+        int index = texture->uploaded++;
+        // with linear filtering the edges would blend with the opposite side
+        texture->tiles[index] = total == 1 ? 
+            createTexture(image, SG_WRAP_CLAMP_TO_EDGE) : 
+            uploadTile(texture, image, index);
+    }
+    return texture->uploaded == total;
+}
+
+void freeTiledTexture(TiledTexture texture) {
+    if (!texture.tiles) return;
+    for (int i = 0; i < texture.uploaded; ++i) {
+        if (texture.tiles[i].id != 0) {
+            freeTexture(texture.tiles[i]);
+        }
+    }
+    free(texture.tiles);
+}
+
 /* +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-
             BATCH FUNCTIONS            
 +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+- */
@@ -313,15 +1119,18 @@ static void batchDraw(void) {
     else
         state.bind.fs_images[SLOT_tex] = (sg_image){ batch.tex.id };
 
+    fs_params_t fs_params = { .grey = batch.tex.grey ? 1.f : 0.f };
+
     sg_apply_pipeline(state.pip);
     sg_apply_bindings(&state.bind);
     sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &SG_RANGE(params));
+    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params, &SG_RANGE(fs_params));
 
     sg_draw(0, batch.icount, 1);
 
     batch.vcount = 0;
     batch.icount = 0;
-    batch.tex.id = SG_INVALID_ID;
+    batch.tex = (Texture){ .id = SG_INVALID_ID };
     batch.mat = matIdentity();
 }
 
@@ -481,6 +1290,37 @@ void drawTilemap(Tilemap tilemap, Colour tint, vec2 offset) {
     }
 }
 
+void drawTextureImmediate(Texture texture, Rect dst, Rect clip, vec2 screen, float dpi_scale) {
+    Vertex vertices[4];
+    vec4 col = vec4One();
+    vertices[0] = (Vertex){ { dst.x,         dst.y },         { 0, 0 }, col };
+    vertices[1] = (Vertex){ { dst.x + dst.w, dst.y },         { 1, 0 }, col };
+    vertices[2] = (Vertex){ { dst.x + dst.w, dst.y + dst.h }, { 1, 1 }, col };
+    vertices[3] = (Vertex){ { dst.x,         dst.y + dst.h }, { 0, 1 }, col };
+
+    if (sg_query_buffer_will_overflow(state.imm_vbuf, sizeof(vertices))) {
+        REPEAT_N(1, warn("more than %d immediate quads in a frame", MAX_IMMEDIATE_QUADS));
+        return;
+    }
+    int offset = sg_append_buffer(state.imm_vbuf, &SG_RANGE(vertices));
+
+    sg_bindings bind = {
+        .vertex_buffers[0] = state.imm_vbuf,
+        .vertex_buffer_offsets[0] = offset,
+        .index_buffer = state.imm_ibuf,
+        .fs_images[SLOT_tex] = { texture.id },
+    };
+    vs_params_t vs_params = { .transform = mat4Ortho(0, screen.x, 0, screen.y, 0, 1) };
+    fs_params_t fs_params = { .grey = texture.grey ? 1.f : 0.f };
+
+    sg_apply_pipeline(state.pip);
+    sg_apply_scissor_rectf(clip.x * dpi_scale, clip.y * dpi_scale, clip.w * dpi_scale, clip.h * dpi_scale, true);
+    sg_apply_bindings(&bind);
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &SG_RANGE(vs_params));
+    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params, &SG_RANGE(fs_params));
+    sg_draw(0, 6, 1);
+}
+
 /* +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-
 -- for future reference 'cause i'm bad at math
   3x2 matrix (3 rows, 2 columns)
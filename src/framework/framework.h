@@ -14,6 +14,7 @@ TODO
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef unsigned char uchar;
 typedef unsigned int uint;
@@ -61,15 +62,77 @@ typedef struct {
     uchar r, g, b, a;
 } Colour;
 
+typedef enum {
+    IMAGE_RGBA8,
+    // 8 bytes for every 4x4 block of pixels
+    IMAGE_BC1,
+    // greyscale, 1 byte per pixel
+    IMAGE_R8,
+    // greyscale, 8 bytes for every 4x4 block of pixels
+    IMAGE_BC4,
+} ImageFormat;
+
 typedef struct {
     uchar *data;
     int width, height;
+    ImageFormat format;
+    // mip levels stored one after the other after the full size one, 0 and
+    // 1 both mean there's only the full size one
+    int mipmaps;
+    // start of the file mapping when the image comes from mapRawImage
+    void *mapping;
 } Image;
 
+#define RAW_IMAGE_MAGIC "JRI2"
+
+// raw image files are this header followed by rows of stride bytes (rows
+// of pixels or of 4x4 blocks depending on the format), so they can be
+// uploaded without decoding them. stride is for the full size level, the
+// mip levels come right after it
+typedef struct {
+    char magic[4];
+    u32 width;
+    u32 height;
+    u32 stride;
+    u32 format;
+    u32 mipmaps;
+    u32 reserved[2];
+} RawImageHeader;
+
 typedef struct {
     uint id;
+    // single channel texture, the shader spreads red to all channels
+    bool grey;
 } Texture;
 
+// images too big for a single texture are split in a grid of tiles, each
+// its own texture. images that fit are a 1x1 grid with every mip level,
+// tiles only keep the levels that line up with the grid
+typedef struct {
+    // cols * rows, row after row. the ones not uploaded yet have id 0
+    Texture *tiles;
+    int cols, rows;
+    int tile_width, tile_height;
+    int width, height;
+    // tiles are uploaded in order, this is the next one
+    int uploaded;
+} TiledTexture;
+
+typedef struct {
+    int workers;
+    int queued;
+    int capacity;
+    u64 done;
+    double avg_wait_ms;
+    double avg_decode_ms;
+} DecodeStats;
+
+// called from a decode worker, image.data is NULL if the decoding failed
+typedef void (*ImageLoadedCb)(Image image, void *udata);
+// called from a decode worker between the steps of the decoding, returning
+// true drops the image and the loaded callback gets an empty one
+typedef bool (*ImageCancelCb)(void *udata);
+
 typedef struct {
     Texture tex;
     Rect uv;
@@ -141,10 +204,57 @@ void freeAnimSprite(AnimSprite sprite);
 Image loadImage(const char *filename);
 Image loadImageFromMemory(const uchar *data, uint len);
 void freeImage(Image image);
+size_t imageDataSize(Image image);
+
+// the decode pool is started by initFramework with one worker per core,
+// it can also be used on its own (workers <= 0 means one per core)
+void initDecodePool(int workers);
+void cleanupDecodePool(void);
+// decodes the image on the pool, data must stay valid until the callback is
+// called. waits if the pool already has too many images queued
+void loadImageFromMemoryAsync(const uchar *data, uint len, ImageLoadedCb callback, void *udata);
+// same as loadImageFromMemoryAsync, cancelled can be NULL
+void loadImageFromMemoryAsyncEx(const uchar *data, uint len, ImageLoadedCb callback, ImageCancelCb cancelled, void *udata);
+DecodeStats decodeStats(void);
+// block compress the images decoded on the pool when the gpu supports it,
+// they use a fraction of the memory but lose a bit of quality. must be
+// called after initFramework
+void setImageCompression(bool enabled);
+// keep the images decoded on the pool with a single channel when they are
+// greyscale, either in the file or because all their pixels are grey
+void setGreyscaleDetection(bool enabled);
+// generate the mip chain of the images decoded on the pool, pages drawn
+// smaller than their size look a lot better for 1/3 more memory
+void setImageMipmaps(bool enabled);
+
+// small RGBA8 copy of the image, between max_height / 2 and max_height
+// tall. works with every format and uses the mips when there are any, so
+// it's cheap enough for the worker threads
+Image makeThumbnail(Image image, int max_height);
+
+RawImageHeader rawImageHeader(Image image);
+// maps the file in memory, data points straight into the mapping which is
+// released by freeImage. data is NULL if the file isn't a valid raw image
+Image mapRawImage(const char *filename);
 
 Texture loadTexture(const char *filename);
 Texture loadTextureFromImage(Image image);
 void freeTexture(Texture texture);
+// RGBA8 texture that can be changed after it's made, with
+// updateDynamicTexture. size is width * height * 4, the whole texture is
+// replaced every time and only once per frame
+Texture makeDynamicTexture(int width, int height);
+void updateDynamicTexture(Texture texture, const uchar *rgba, size_t size);
+
+// only sets up the grid, nothing is uploaded until uploadTextureTiles
+TiledTexture makeTiledTexture(Image image);
+// uploads up to count tiles, the image must be the one the grid was made
+// from. returns true once every tile is uploaded
+bool uploadTextureTiles(TiledTexture *texture, Image image, int count);
+void freeTiledTexture(TiledTexture texture);
+Texture tiledTextureTile(TiledTexture texture, int col, int row);
+// area of the image covered by the tile, in pixels
+Rect tiledTextureTileRect(TiledTexture texture, int col, int row);
 
 void drawTexture(Texture texture, vec2 position);
 void drawTexturePro(Texture texture, Colour tint, Rect uv, vec2 pos, vec2 size, vec2 scale, float rotation, vec2 origin);
@@ -152,6 +262,10 @@ void drawTextureMat(Texture texture, Colour tint, Rect uv, vec2 size, matrix mat
 void drawSprite(Sprite sprite);
 void drawAnimSprite(AnimSprite sprite);
 void drawTilemap(Tilemap tilemap, Colour tint, vec2 offset);
+// draws right away instead of going through the batch, for draw callbacks
+// that run in the middle of someone else's pass (e.g. ImGui's). dst and clip
+// are in points, screen is the size of the screen in points
+void drawTextureImmediate(Texture texture, Rect dst, Rect clip, vec2 screen, float dpi_scale);
 
 #ifndef PI
     #define PI 3.14159265358979323846f
@@ -0,0 +1,262 @@
+#include "texcompress.h"
+
+#include <string.h>
+
+/* +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-
+BC1 encoder
+ - endpoints are the corners of the block's colour bounding box, moved
+   slightly inwards, rounded to the nearest 565 colour
+ - always uses the 4 colour mode, pages are opaque
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+- */
+
+static u16 to565(int r, int g, int b) {
+    r = (r * 31 + 127) / 255;
+    g = (g * 63 + 127) / 255;
+    b = (b * 31 + 127) / 255;
+    return (u16)((r << 11) | (g << 5) | b);
+}
+
+static void from565(u16 c, int *out) {
+    int r = (c >> 11) & 31;
+    int g = (c >> 5) & 63;
+    int b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+static void compressBlock(const uchar *block[4], uchar *out) {
+    int lo[3] = { 255, 255, 255 };
+    int hi[3] = { 0, 0, 0 };
+
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            const uchar *p = block[y] + x * 4;
+            for (int c = 0; c < 3; ++c) {
+                if (p[c] < lo[c]) lo[c] = p[c];
+                if (p[c] > hi[c]) hi[c] = p[c];
+            }
+        }
+    }
+
+    // inset the box by 1/16th so the endpoints land closer to the real colours
+    for (int c = 0; c < 3; ++c) {
+        int inset = (hi[c] - lo[c]) >> 4;
+        lo[c] += inset;
+        hi[c] -= inset;
+    }
+
+    u16 c0 = to565(hi[0], hi[1], hi[2]);
+    u16 c1 = to565(lo[0], lo[1], lo[2]);
+    u32 indices = 0;
+
+    if (c0 < c1) {
+        u16 tmp = c0;
+        c0 = c1;
+        c1 = tmp;
+    }
+
+    // with c0 == c1 the block would be in 3 colour mode, index 0 is fine for all pixels
+    if (c0 != c1) {
+        int palette[4][3];
+        from565(c0, palette[0]);
+        from565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 15; i >= 0; --i) {
+            const uchar *p = block[i / 4] + (i % 4) * 4;
+            int best = 0;
+            int best_dist = 0x7fffffff;
+            for (int j = 0; j < 4; ++j) {
+                int dr = p[0] - palette[j][0];
+                int dg = p[1] - palette[j][1];
+                int db = p[2] - palette[j][2];
+                int dist = dr * dr + dg * dg + db * db;
+                if (dist < best_dist) {
+                    best = j;
+                    best_dist = dist;
+                }
+            }
+            indices = (indices << 2) | (u32)best;
+        }
+    }
+
+    out[0] = (uchar)(c0 & 0xff);
+    out[1] = (uchar)(c0 >> 8);
+    out[2] = (uchar)(c1 & 0xff);
+    out[3] = (uchar)(c1 >> 8);
+    out[4] = (uchar)(indices & 0xff);
+    out[5] = (uchar)((indices >> 8) & 0xff);
+    out[6] = (uchar)((indices >> 16) & 0xff);
+    out[7] = (uchar)(indices >> 24);
+}
+
+size_t bc1Size(int width, int height) {
+    return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * 8;
+}
+
+// blocks that go past the right or bottom edge repeat the last column/row
+static void getBlock(const uchar *pixels, int width, int height, int stride, int channels, int bx, int by, uchar *padded, const uchar *block[4]) {
+    for (int y = 0; y < 4; ++y) {
+        int row = by + y < height ? by + y : height - 1;
+        block[y] = pixels + (size_t)row * stride + (size_t)bx * channels;
+    }
+    if (bx + 4 <= width) return;
+
+    for (int y = 0; y < 4; ++y) {
+        uchar *dst = padded + y * 4 * channels;
+        for (int x = 0; x < 4; ++x) {
+            int col = bx + x < width ? x : width - 1 - bx;
+            memcpy(dst + x * channels, block[y] + col * channels, channels);
+        }
+        block[y] = dst;
+    }
+}
+
+void compressBC1(const uchar *rgba, int width, int height, int stride, uchar *out) {
+    uchar padded[4 * 4 * 4];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            const uchar *block[4];
+            getBlock(rgba, width, height, stride, 4, bx, by, padded, block);
+            compressBlock(block, out);
+            out += 8;
+        }
+    }
+}
+
+/* +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-
+BC4 encoder
+ - endpoints are the block's min and max, always in the 8 value mode
+ - every pixel picks the closest of the 8 values
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+- */
+
+static void compressBlockBC4(const uchar *block[4], uchar *out) {
+    int lo = 255;
+    int hi = 0;
+
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            int v = block[y][x];
+            if (v < lo) lo = v;
+            if (v > hi) hi = v;
+        }
+    }
+
+    u64 indices = 0;
+
+    // with hi == lo every value decodes to hi, index 0 is fine for all pixels
+    if (hi != lo) {
+        int range = hi - lo;
+        for (int i = 15; i >= 0; --i) {
+            int v = block[i / 4][i % 4];
+            // 0 is hi and 7 is lo, the values in between are evenly spaced
+            int step = ((hi - v) * 7 + range / 2) / range;
+            // but index 0 and 1 are the endpoints, the steps come after
+            int index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            indices = (indices << 3) | (u64)index;
+        }
+    }
+
+    out[0] = (uchar)hi;
+    out[1] = (uchar)lo;
+    for (int i = 0; i < 6; ++i) {
+        out[2 + i] = (uchar)((indices >> (i * 8)) & 0xff);
+    }
+}
+
+size_t bc4Size(int width, int height) {
+    return bc1Size(width, height);
+}
+
+void compressBC4(const uchar *grey, int width, int height, int stride, uchar *out) {
+    uchar padded[4 * 4];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            const uchar *block[4];
+            getBlock(grey, width, height, stride, 1, bx, by, padded, block);
+            compressBlockBC4(block, out);
+            out += 8;
+        }
+    }
+}
+
+/* +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-
+Decoders
+ - both modes of BC1 and BC4, not only the ones the encoders use
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+- */
+
+static void decompressBlockBC1(const uchar *block, uchar palette[4][4]) {
+    u16 c0 = (u16)(block[0] | (block[1] << 8));
+    u16 c1 = (u16)(block[2] | (block[3] << 8));
+    int p0[3], p1[3];
+    from565(c0, p0);
+    from565(c1, p1);
+
+    for (int c = 0; c < 3; ++c) {
+        palette[0][c] = (uchar)p0[c];
+        palette[1][c] = (uchar)p1[c];
+        if (c0 > c1) {
+            palette[2][c] = (uchar)((2 * p0[c] + p1[c]) / 3);
+            palette[3][c] = (uchar)((p0[c] + 2 * p1[c]) / 3);
+        }
+        else {
+            palette[2][c] = (uchar)((p0[c] + p1[c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    palette[0][3] = palette[1][3] = palette[2][3] = 255;
+    palette[3][3] = c0 > c1 ? 255 : 0;
+}
+
+void decompressBC1(const uchar *blocks, int width, int height, uchar *out) {
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            uchar palette[4][4];
+            decompressBlockBC1(blocks, palette);
+            u32 indices = (u32)blocks[4] | ((u32)blocks[5] << 8) | ((u32)blocks[6] << 16) | ((u32)blocks[7] << 24);
+            for (int i = 0; i < 16; ++i) {
+                int x = bx + i % 4;
+                int y = by + i / 4;
+                if (x < width && y < height) {
+                    memcpy(out + ((size_t)y * width + x) * 4, palette[(indices >> (i * 2)) & 3], 4);
+                }
+            }
+            blocks += 8;
+        }
+    }
+}
+
+void decompressBC4(const uchar *blocks, int width, int height, uchar *out) {
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            int r0 = blocks[0];
+            int r1 = blocks[1];
+            uchar palette[8] = { (uchar)r0, (uchar)r1 };
+            if (r0 > r1) {
+                for (int k = 1; k < 7; ++k) palette[k + 1] = (uchar)(((7 - k) * r0 + k * r1) / 7);
+            }
+            else {
+                for (int k = 1; k < 5; ++k) palette[k + 1] = (uchar)(((5 - k) * r0 + k * r1) / 5);
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+
+            u64 indices = 0;
+            for (int i = 0; i < 6; ++i) {
+                indices |= (u64)blocks[2 + i] << (i * 8);
+            }
+            for (int i = 0; i < 16; ++i) {
+                int x = bx + i % 4;
+                int y = by + i / 4;
+                if (x < width && y < height) {
+                    out[(size_t)y * width + x] = palette[(indices >> (i * 3)) & 7];
+                }
+            }
+            blocks += 8;
+        }
+    }
+}
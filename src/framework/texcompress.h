@@ -0,0 +1,19 @@
+#pragma once
+
+#include "framework.h"
+
+// size in bytes of a BC1 image, 8 bytes for every 4x4 block
+size_t bc1Size(int width, int height);
+// stride is in bytes, when the size isn't a multiple of 4 the edge blocks
+// repeat the last row/column
+void compressBC1(const uchar *rgba, int width, int height, int stride, uchar *out);
+
+// size in bytes of a BC4 image, also 8 bytes for every 4x4 block
+size_t bc4Size(int width, int height);
+// single channel version of compressBC1, grey has one byte per pixel
+void compressBC4(const uchar *grey, int width, int height, int stride, uchar *out);
+
+// the other way around, for the few places that need the pixels back.
+// out has 4 bytes per pixel for BC1 and 1 for BC4
+void decompressBC1(const uchar *blocks, int width, int height, uchar *out);
+void decompressBC4(const uchar *blocks, int width, int height, uchar *out);
@@ -0,0 +1,374 @@
+#include "loader.h"
+
+#include <chrono>
+
+#include "utils/http.h"
+#include "tracelog.h"
+#include "stats.h"
+#include "chrome_trace.h"
+
+static i64 now_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// shared with the stats overlay, pages in each stage and how long they took
+static Counter &fetching = stats().counter("pages_fetching");
+static Counter &decoding_pages = stats().counter("pages_decoding");
+static Histogram &fetch_us = stats().histogram("fetch_us");
+static Histogram &decode_us = stats().histogram("decode_us");
+
+void Downloader::stage_counter::add(i64 wait, i64 work) {
+    wait_us += wait;
+    work_us += work;
+    ++done;
+}
+
+void Downloader::init(PageCache *cache, PageCache *decoded, int download_workers, int per_host) {
+    page_cache = cache;
+    decoded_cache = decoded;
+    conn_per_host = per_host > 0 ? per_host : 1;
+    stopping = false;
+
+    upload_queue.init(upload_queue_len);
+
+    fetch_count = download_workers;
+    if (fetch_count > max_download_workers) fetch_count = max_download_workers;
+    if (fetch_count < 1) fetch_count = 1;
+
+    for (int i = 0; i < fetch_count; ++i) {
+        fetch_threads[i] = std::thread([this](){ fetch_worker(); });
+    }
+    info("started %d download workers, max %d per host", fetch_count, conn_per_host);
+}
+
+void Downloader::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cond.notify_all();
+    upload_queue.close();
+
+    for (int i = 0; i < fetch_count; ++i) {
+        if (fetch_threads[i].joinable()) {
+            fetch_threads[i].join();
+        }
+    }
+    fetch_count = 0;
+
+    // the decode pool outlives us, wait for it to hand back our pages
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cond.wait(lock, [this](){ return decoding == 0; });
+    }
+
+    // nobody is going to upload these anymore
+    decoded_page page;
+    while (upload_queue.try_pop(page)) {
+        freeImage(page.page.img);
+        freeImage(page.page.thumb);
+    }
+    for (auto &b : buffers) {
+        free(b.data);
+    }
+    buffers.clear();
+}
+
+void Downloader::push(const DownloadJob &job) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        queue.append(job);
+        // parsed once here, pop_job runs over the whole queue on every wakeup
+        queue.back().queued_at = now_us();
+        queue.back().host = host_index(http::parse_url(job.url).host);
+    }
+    cond.notify_one();
+}
+
+void Downloader::cancel() {
+    ++generation;
+    // wake up the workers so they can drain the stale jobs right away
+    cond.notify_all();
+}
+
+bool Downloader::pop_loaded(LoadedPage &out) {
+    decoded_page page;
+    if (!upload_queue.try_pop(page)) {
+        return false;
+    }
+    counters[STAGE_UPLOAD].wait_us += now_us() - page.queued_at;
+    out = page.page;
+    return true;
+}
+
+void Downloader::upload_done(double ms) {
+    counters[STAGE_UPLOAD].work_us += (i64)(ms * 1000.0);
+    ++counters[STAGE_UPLOAD].done;
+}
+
+void Downloader::get_stats(StageStats out[STAGE_COUNT]) {
+    static const char *names[STAGE_COUNT] = { "fetch", "decode", "upload" };
+
+    int fetch_depth = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fetch_depth = (int)queue.len;
+    }
+
+    int depths[STAGE_COUNT] = { fetch_depth, 0, (int)upload_queue.size() };
+    int capacities[STAGE_COUNT] = { 0, 0, (int)upload_queue.capacity() };
+
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        u64 done = counters[i].done;
+        double div = done ? done * 1000.0 : 1.0;
+        out[i] = {
+            names[i],
+            depths[i],
+            capacities[i],
+            done,
+            counters[i].wait_us / div,
+            counters[i].work_us / div,
+        };
+    }
+
+    // the decode pool keeps its own numbers
+    DecodeStats decode = decodeStats();
+    out[STAGE_DECODE].depth = decode.queued;
+    out[STAGE_DECODE].capacity = decode.capacity;
+    out[STAGE_DECODE].done = decode.done;
+    out[STAGE_DECODE].avg_wait_ms = decode.avg_wait_ms;
+    out[STAGE_DECODE].avg_work_ms = decode.avg_decode_ms;
+}
+
+// must be called with mtx locked
+int Downloader::host_index(str_view host) {
+    for (usize i = 0; i < hosts.len; ++i) {
+        if (hosts[i].host == host) {
+            return (int)i;
+        }
+    }
+    hosts.append({ host, 0 });
+    return (int)hosts.len - 1;
+}
+
+// pages behind the focus were most likely already read, so they count double
+static usize job_distance(const DownloadJob &job, usize focus) {
+    usize slot = (usize)job.slot;
+    return slot >= focus ? slot - focus : (focus - slot) * 2;
+}
+
+// must be called with mtx locked
+bool Downloader::pop_job(DownloadJob &out, bool &has_slot) {
+    usize cur_focus = focus;
+    has_slot = false;
+    usize best = queue.len;
+    host_slot *best_host = nullptr;
+
+    for (usize i = 0; i < queue.len; ++i) {
+        const auto &job = queue[i];
+        // stale jobs don't open any connection, let them through right away
+        if (job.generation != generation) {
+            out = job;
+            queue.remove(i, false);
+            return true;
+        }
+
+        if (best < queue.len && job_distance(job, cur_focus) >= job_distance(queue[best], cur_focus)) {
+            continue;
+        }
+
+        host_slot *host = &hosts[(usize)job.host];
+        if (host->active < conn_per_host) {
+            best = i;
+            best_host = host;
+        }
+    }
+
+    if (best == queue.len) {
+        return false;
+    }
+
+    ++best_host->active;
+    has_slot = true;
+    out = queue[best];
+    queue.remove(best, false);
+    return true;
+}
+
+Image Downloader::map_decoded(str_view url) {
+    char path[300];
+    if (!decoded_cache || !decoded_cache->lookup(url, path, sizeof(path))) {
+        return {};
+    }
+    Image img = mapRawImage(path);
+    if (!img.data) {
+        decoded_cache->remove(url);
+        ++decoded_cache->misses;
+        return img;
+    }
+    ++decoded_cache->hits;
+    return img;
+}
+
+void Downloader::take_buffer(vec<u8> &body) {
+    if (body.buf) return;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (buffers.len > 0) {
+        free_buffer b = buffers.back();
+        buffers.remove(buffers.len - 1);
+        body.buf = b.data;
+        body.cap = b.cap;
+    }
+    body.len = 0;
+}
+
+void Downloader::give_buffer(u8 *data, usize cap) {
+    if (!data) return;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    buffers.append({ data, cap });
+}
+
+void Downloader::fetch_worker() {
+    spanThreadName("fetch worker");
+    vec<u8> body;
+
+    while (true) {
+        DownloadJob job;
+        bool has_slot = false;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cond.wait(lock, [&](){ return stopping || pop_job(job, has_slot); });
+            if (stopping) return;
+        }
+
+        // cancelled after it was popped, it may still hold a slot
+        if (job.generation != generation) {
+            if (has_slot) {
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    --hosts[(usize)job.host].active;
+                }
+                cond.notify_all();
+            }
+            finish_page({ job, {}, false, {} });
+            continue;
+        }
+
+        spanBegin("fetch page");
+        i64 start = now_us();
+        fetching.add(1);
+        http::url url = http::parse_url(job.url);
+        take_buffer(body);
+
+        Image mapped = map_decoded(job.url);
+        bool success = mapped.data || (page_cache && page_cache->get(job.url, body));
+        if (!success) {
+            // a cancel() drops the request within a few ms, even mid transfer
+            auto res = http::get(url.host, url.uri, body, url.port, { &generation, job.generation });
+            if (res.bad() && res.error == http::REQERR_CANCELLED) {
+                debug("req for page %d cancelled", job.page_num);
+            }
+            else if (res.bad()) {
+                err("req for page %d failed: %s", job.page_num, http::req_error_str(res.error));
+            }
+            else if (res.result.status != http::STATUS_OK) {
+                err("req for page %d failed: %d", job.page_num, (int)res.result.status);
+            }
+            else {
+                success = true;
+                if (page_cache) {
+                    page_cache->put(job.url, body);
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            --hosts[(usize)job.host].active;
+        }
+        // a slot for this host just freed up
+        cond.notify_all();
+
+        counters[STAGE_FETCH].add(start - job.queued_at, now_us() - start);
+        fetch_us.record((u64)(now_us() - start));
+        fetching.add(-1);
+        spanEnd();
+
+        if (mapped.data) {
+            finish_page({ job, mapped, true, make_thumbnail(job, mapped) });
+            continue;
+        }
+
+        if (!success) {
+            finish_page({ job, {}, false, {} });
+            continue;
+        }
+
+        // the decode pool owns the buffer now, it's given back in on_decoded
+        fetched_page *page = (fetched_page *)malloc(sizeof(fetched_page));
+        *page = { this, job, body.buf, body.cap, now_us() };
+        slice<u8> data = { body.buf, body.len };
+        body.buf = nullptr;
+        body.len = 0;
+        body.cap = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            ++decoding;
+        }
+        decoding_pages.add(1);
+        // waits here while the decoders are behind
+        loadImageFromMemoryAsyncEx(data.buf, (uint)data.len, on_decoded, is_stale, page);
+    }
+}
+
+void Downloader::on_decoded(Image img, void *udata) {
+    fetched_page *page = (fetched_page *)udata;
+    Downloader *self = page->self;
+
+    self->give_buffer(page->data, page->cap);
+    // queue wait included, it's what the reader sees
+    decode_us.record((u64)(now_us() - page->decode_start));
+    decoding_pages.add(-1);
+
+    if (img.data && self->decoded_cache) {
+        RawImageHeader header = rawImageHeader(img);
+        self->decoded_cache->put(
+            page->job.url,
+            { img.data, imageDataSize(img) },
+            { (u8 *)&header, sizeof(header) }
+        );
+    }
+
+    // still on the decode worker
+    Image thumb = img.data ? self->make_thumbnail(page->job, img) : Image{};
+    self->finish_page({ page->job, img, img.data != nullptr, thumb });
+    free(page);
+
+    {
+        std::lock_guard<std::mutex> lock(self->mtx);
+        --self->decoding;
+    }
+    self->cond.notify_all();
+}
+
+bool Downloader::is_stale(void *udata) {
+    fetched_page *page = (fetched_page *)udata;
+    return page->job.generation != page->self->generation;
+}
+
+Image Downloader::make_thumbnail(const DownloadJob &job, Image img) {
+    int height = thumb_height;
+    return height > 0 && job.thumb ? makeThumbnail(img, height) : Image{};
+}
+
+void Downloader::finish_page(const LoadedPage &page) {
+    // waits here while the main thread is behind with the uploads
+    if (!upload_queue.push({ page, now_us() })) {
+        freeImage(page.img);
+        freeImage(page.thumb);
+    }
+}
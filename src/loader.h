@@ -0,0 +1,167 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "utils/vec.h"
+#include "utils/str.h"
+#include "utils/mpsc_ring.h"
+
+#include "framework/framework.h"
+
+#include "page_cache.h"
+
+constexpr int max_download_workers = 16;
+constexpr int default_download_workers = 8;
+constexpr int default_conn_per_host = 4;
+// how many decoded pages can wait for the main thread before the decoders stall
+constexpr int upload_queue_len = 16;
+
+enum PipelineStage {
+    STAGE_FETCH,
+    STAGE_DECODE,
+    STAGE_UPLOAD,
+    STAGE_COUNT,
+};
+
+struct StageStats {
+    const char *name;
+    // pages waiting in front of the stage, capacity is 0 when unbounded
+    int depth;
+    int capacity;
+    u64 done;
+    // average time spent waiting in the queue and inside the stage
+    double avg_wait_ms;
+    double avg_work_ms;
+};
+
+struct DownloadJob {
+    // points into the chapter's url list, which lives as long as the reader
+    str_view url;
+    int slot;
+    int page_num;
+    int chap_id;
+    int generation;
+    // false when the reader already has the page's thumbnail
+    bool thumb;
+    // set by push
+    i64 queued_at;
+    int host;
+};
+
+// a finished job waiting to be uploaded, success is false when the download
+// failed or the job was cancelled
+struct LoadedPage {
+    DownloadJob job;
+    Image img;
+    bool success;
+    // made next to the page when thumbnails are on, data is NULL otherwise
+    Image thumb;
+};
+
+// pages go through three stages connected by bounded queues:
+// - fetch: download_workers threads sharing the job queue, jobs are started
+//   in the order they were pushed, but never more than conn_per_host at the
+//   same time for the same host. pages found in the cache skip the download,
+//   and pages found in the decoded cache are mapped and skip the decode too
+// - decode: the framework's decode pool (loadImageFromMemoryAsync)
+// - upload: the main thread, which drains the queue with pop_loaded()
+//   without ever waiting, the queue in front of it is lock-free
+// when a queue is full the stage before it waits, so a slow decoder or a
+// stalled frame doesn't make the downloaded pages pile up in memory.
+// queued jobs are started by distance of their slot from the focus slot
+struct Downloader {
+    // both caches can be null, decoded holds raw images (see mapRawImage)
+    void init(PageCache *cache, PageCache *decoded, int download_workers = default_download_workers, int per_host = default_conn_per_host);
+    void shutdown();
+
+    void push(const DownloadJob &job);
+    // drops every job from the current generation. the ones already running
+    // stop at the next socket wait or decode step and are reported as failed
+    void cancel();
+
+    int cur_generation() const { return generation; }
+
+    // usually the slot of the page being read
+    void set_focus(usize slot) { focus = slot; }
+    // 0 turns them off, see makeThumbnail
+    void set_thumbnails(int max_height) { thumb_height = max_height; }
+
+    // main thread only, never blocks. call upload_done() with the time it
+    // took to upload the page to time the upload stage
+    bool pop_loaded(LoadedPage &out);
+    void upload_done(double ms);
+    usize upload_queued() const { return upload_queue.size(); }
+
+    void get_stats(StageStats out[STAGE_COUNT]);
+
+private:
+    struct host_slot {
+        str_view host;
+        int active;
+    };
+
+    // owned by the decode pool until on_decoded is called
+    struct fetched_page {
+        Downloader *self;
+        DownloadJob job;
+        u8 *data;
+        usize cap;
+        i64 decode_start;
+    };
+
+    struct decoded_page {
+        LoadedPage page;
+        i64 queued_at;
+    };
+
+    struct free_buffer {
+        u8 *data;
+        usize cap;
+    };
+
+    struct stage_counter {
+        std::atomic<u64> done = 0;
+        std::atomic<i64> wait_us = 0;
+        std::atomic<i64> work_us = 0;
+
+        void add(i64 wait, i64 work);
+    };
+
+    void fetch_worker();
+    static void on_decoded(Image img, void *udata);
+    static bool is_stale(void *udata);
+    void finish_page(const LoadedPage &page);
+    Image make_thumbnail(const DownloadJob &job, Image img);
+    // has_slot is set when the job took one of its host's connection slots
+    bool pop_job(DownloadJob &out, bool &has_slot);
+    Image map_decoded(str_view url);
+    int host_index(str_view host);
+    void take_buffer(vec<u8> &body);
+    void give_buffer(u8 *data, usize cap);
+
+    std::mutex mtx;
+    std::condition_variable cond;
+    vec<DownloadJob> queue;
+    vec<host_slot> hosts;
+    // download buffers are passed to the decoders and then recycled
+    vec<free_buffer> buffers;
+
+    // filled by the fetch workers and the decode pool, drained by the main thread
+    mpsc_ring<decoded_page> upload_queue;
+    // pages handed to the decode pool that didn't come back yet
+    int decoding = 0;
+    stage_counter counters[STAGE_COUNT];
+
+    std::thread fetch_threads[max_download_workers];
+    int fetch_count = 0;
+    int conn_per_host = default_conn_per_host;
+    PageCache *page_cache = nullptr;
+    PageCache *decoded_cache = nullptr;
+    std::atomic<bool> stopping = false;
+    std::atomic<int> generation = 0;
+    std::atomic<usize> focus = 0;
+    std::atomic<int> thumb_height = 0;
+};
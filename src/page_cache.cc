@@ -0,0 +1,261 @@
+#include "page_cache.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include <dir.h>
+
+#include "tracelog.h"
+
+// fnv-1a
+static u64 hash_url(str_view url) {
+    u64 hash = 14695981039346656037ull;
+    for (usize i = 0; i < url.len; ++i) {
+        hash ^= (u8)url.buf[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// false if the file is still there, windows can't delete a file while
+// it's mapped
+static bool remove_file(const char *path) {
+    return ::remove(path) == 0 || errno == ENOENT;
+}
+
+void PageCache::init(const char *directory, usize max_bytes, const char *extension) {
+    std::lock_guard<std::mutex> lock(mtx);
+
+    snprintf(dir, sizeof(dir), "%s", directory);
+    snprintf(ext, sizeof(ext), "%s", extension);
+    max_size = max_bytes;
+    total_size = 0;
+    clock = 0;
+    entries.clear();
+
+    // create the parent folders first
+    for (char *c = dir; *c; ++c) {
+        if (*c == '/' && c != dir) {
+            *c = '\0';
+            dirCreate(dir);
+            *c = '/';
+        }
+    }
+    if (!dirCreate(dir)) {
+        err("couldn't create page cache folder %s", dir);
+        return;
+    }
+    initialized = true;
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s/index.txt", dir);
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        info("no page cache index in %s, starting empty", dir);
+        return;
+    }
+
+    entry e;
+    while (fscanf(fp, "%" SCNx64 " %" SCNu64 " %" SCNu64 "\n", &e.key, &e.size, &e.last_used) == 3) {
+        entries.append(e);
+        total_size += e.size;
+        if (e.last_used >= clock) clock = e.last_used + 1;
+    }
+    fclose(fp);
+
+    info("page cache: %d pages, %.1f MB", (int)entries.len, total_size / (1024.0 * 1024.0));
+    evict();
+}
+
+void PageCache::save() {
+    std::lock_guard<std::mutex> lock(mtx);
+    save_locked();
+}
+
+bool PageCache::get(str_view url, vec<u8> &out) {
+    u64 key = hash_url(url);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        entry *e = find(key);
+        if (!e) {
+            ++misses;
+            return false;
+        }
+        e->last_used = clock++;
+        ++changes;
+    }
+
+    char path[300];
+    file_path(key, path, sizeof(path));
+
+    // read outside of the lock, if the file gets evicted meanwhile it's just a miss
+    FILE *fp = fopen(path, "rb");
+    bool success = false;
+    if (fp) {
+        fseek(fp, 0, SEEK_END);
+        long len = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (len > 0) {
+            out.grow((usize)len);
+            out.len = fread(out.buf, 1, (usize)len, fp);
+            success = out.len == (usize)len;
+        }
+        fclose(fp);
+    }
+
+    if (!success) {
+        // the file is gone or broken, forget about it
+        remove(url);
+        out.len = 0;
+        ++misses;
+        return false;
+    }
+
+    ++hits;
+    return true;
+}
+
+bool PageCache::lookup(str_view url, char *path, usize path_len) {
+    u64 key = hash_url(url);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        entry *e = find(key);
+        if (!e) {
+            ++misses;
+            return false;
+        }
+        e->last_used = clock++;
+        ++changes;
+    }
+
+    file_path(key, path, path_len);
+    return true;
+}
+
+void PageCache::remove(str_view url) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (entry *e = find(hash_url(url))) {
+        char path[300];
+        file_path(e->key, path, sizeof(path));
+        if (!remove_file(path)) {
+            err("couldn't remove %s", path);
+            return;
+        }
+        total_size -= e->size;
+        entries.remove(e - entries.buf);
+        ++changes;
+    }
+}
+
+void PageCache::put(str_view url, slice<u8> data, slice<u8> head) {
+    usize size = head.len + data.len;
+    if (!initialized || size == 0 || size > max_size) return;
+
+    u64 key = hash_url(url);
+    char tmp_path[300], path[300];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/%016" PRIx64 ".%u.tmp", dir, key, (unsigned)++tmp_serial);
+    file_path(key, path, sizeof(path));
+
+    // written to a temporary file first so a page is never half on disk
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        err("couldn't open %s", tmp_path);
+        return;
+    }
+    bool written =
+        (head.len == 0 || fwrite(head.buf, 1, head.len, fp) == head.len) &&
+        fwrite(data.buf, 1, data.len, fp) == data.len;
+    written = fclose(fp) == 0 && written;
+    if (!written) {
+        err("couldn't write %s", tmp_path);
+        ::remove(tmp_path);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    ::remove(path);
+    if (rename(tmp_path, path) != 0) {
+        err("couldn't move %s to %s", tmp_path, path);
+        ::remove(tmp_path);
+        return;
+    }
+
+    if (entry *e = find(key)) {
+        total_size -= e->size;
+        e->size = size;
+        e->last_used = clock++;
+    }
+    else {
+        entries.append({ key, size, clock++ });
+    }
+    total_size += size;
+
+    evict();
+    if (++changes >= page_cache_flush_every) {
+        save_locked();
+    }
+}
+
+// must be called with mtx locked
+PageCache::entry *PageCache::find(u64 key) {
+    for (auto &e : entries) {
+        if (e.key == key) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+// must be called with mtx locked
+void PageCache::evict() {
+    char path[300];
+    // every page gets one chance, so files that can't be removed don't
+    // keep us here forever
+    usize tries = entries.len;
+    while (total_size > max_size && tries-- > 0) {
+        usize oldest = 0;
+        for (usize i = 1; i < entries.len; ++i) {
+            if (entries[i].last_used < entries[oldest].last_used) {
+                oldest = i;
+            }
+        }
+
+        file_path(entries[oldest].key, path, sizeof(path));
+        if (!remove_file(path)) {
+            // still in use, it's tried again once it's the oldest again
+            entries[oldest].last_used = clock++;
+            continue;
+        }
+        total_size -= entries[oldest].size;
+        entries.remove(oldest);
+        ++changes;
+    }
+}
+
+// must be called with mtx locked
+void PageCache::save_locked() {
+    if (!initialized) return;
+
+    char tmp_path[300], path[300];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/index.tmp", dir);
+    snprintf(path, sizeof(path), "%s/index.txt", dir);
+
+    FILE *fp = fopen(tmp_path, "wb");
+    if (!fp) {
+        err("couldn't save page cache index");
+        return;
+    }
+    for (auto &e : entries) {
+        fprintf(fp, "%016" PRIx64 " %" PRIu64 " %" PRIu64 "\n", e.key, e.size, e.last_used);
+    }
+    fclose(fp);
+
+    ::remove(path);
+    rename(tmp_path, path);
+    changes = 0;
+}
+
+void PageCache::file_path(u64 key, char *buf, usize len) {
+    snprintf(buf, len, "%s/%016" PRIx64 ".%s", dir, key, ext);
+}
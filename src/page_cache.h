@@ -0,0 +1,57 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+
+#include "utils/vec.h"
+#include "utils/str.h"
+#include "utils/slice.h"
+
+constexpr usize default_page_cache_size = 1024ull * 1024 * 1024;
+// the index is written back after this many changes, and on save()
+constexpr int page_cache_flush_every = 32;
+
+// pages stored on disk, one file per url named after its hash.
+// dir/index.txt keeps the size and last use of every file, when the cache
+// grows over max_bytes the least recently used pages are deleted.
+// everything but init can be called from any thread
+struct PageCache {
+    void init(const char *dir = "cache/pages", usize max_bytes = default_page_cache_size, const char *ext = "bin");
+    void save();
+
+    // reads the page in out, reusing its buffer. false if it isn't cached
+    bool get(str_view url, vec<u8> &out);
+    // for callers that open the file themselves, false if it isn't cached.
+    // only misses are counted, the caller counts the hit once the file is good
+    bool lookup(str_view url, char *path, usize path_len);
+    // the file is head followed by data
+    void put(str_view url, slice<u8> data, slice<u8> head = {});
+    void remove(str_view url);
+
+    std::atomic<u64> hits = 0;
+    std::atomic<u64> misses = 0;
+
+private:
+    struct entry {
+        u64 key;
+        u64 size;
+        u64 last_used;
+    };
+
+    entry *find(u64 key);
+    void evict();
+    void save_locked();
+    void file_path(u64 key, char *buf, usize len);
+
+    std::mutex mtx;
+    vec<entry> entries;
+    char dir[256] = {};
+    char ext[8] = {};
+    usize max_size = default_page_cache_size;
+    usize total_size = 0;
+    u64 clock = 0;
+    // keeps the temporary files of concurrent puts of the same url apart
+    std::atomic<u32> tmp_serial = 0;
+    int changes = 0;
+    bool initialized = false;
+};
@@ -0,0 +1,50 @@
+#include "page_layout.h"
+
+void PageLayout::clear() {
+    offsets.clear();
+}
+
+void PageLayout::append(double aspect) {
+    if (offsets.len == 0) {
+        offsets.append(0.0);
+    }
+    offsets.append(offsets.back() + aspect);
+}
+
+void PageLayout::set(usize page, double aspect) {
+    double diff = aspect - (offsets[page + 1] - offsets[page]);
+    for (usize i = page + 1; i < offsets.len; ++i) {
+        offsets[i] += diff;
+    }
+}
+
+double PageLayout::top(usize page, double width) const {
+    return offsets[page] * width + gap * (double)page;
+}
+
+double PageLayout::height(usize page, double width) const {
+    return (offsets[page + 1] - offsets[page]) * width;
+}
+
+double PageLayout::total(double width) const {
+    usize n = count();
+    return n > 0 ? top(n, width) - gap : 0.0;
+}
+
+usize PageLayout::page_at(double y, double width) const {
+    usize lo = 0;
+    usize hi = count();
+    if (hi == 0) return 0;
+
+    // first page starting after y, the one before it is the one we want
+    while (lo < hi) {
+        usize mid = lo + (hi - lo) / 2;
+        if (top(mid, width) <= y) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? lo - 1 : 0;
+}
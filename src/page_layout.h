@@ -0,0 +1,29 @@
+#pragma once
+
+#include "utils/vec.h"
+
+// vertical layout of pages one after the other, all scaled to the same
+// width with a fixed gap between them. it keeps the prefix sums of the
+// pages' aspect ratios, so the position of a page at any width is O(1) and
+// finding the page at a position is a binary search.
+// positions are doubles, with thousands of pages floats lose whole pixels
+struct PageLayout {
+    void clear();
+    // aspect is height / width
+    void append(double aspect);
+    // moves every page after it, O(count)
+    void set(usize page, double aspect);
+
+    usize count() const { return offsets.len > 0 ? offsets.len - 1 : 0; }
+    double top(usize page, double width) const;
+    double height(usize page, double width) const;
+    double total(double width) const;
+    // last page starting at or before y, 0 if there are no pages
+    usize page_at(double y, double width) const;
+
+    double gap = 0.0;
+
+private:
+    // offsets[i] is the sum of the aspect ratios of the pages before i
+    vec<double> offsets;
+};
@@ -4,24 +4,38 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <time.h>
 
 #define IMGUI_DEFINE_MATH_OPERATORS 
 #include "imgui_internal.h"
 
 #include <sokol_app.h>
+#include <sokol_time.h>
 
 #include "utils/http.h"
 
 #include <sokol_fetch.h>
+#include <file.h>
 
 #include "app.h"
 #include "tracelog.h"
+#include "chapter_index.h"
+#include "stats.h"
+#include "chrome_trace.h"
 #include "utils/utils.h"
 
 Reader reader;
 
 static void init_dock();
 static void show_page_num(int page_num, int chap_num, bool *p_open = nullptr);
+static void draw_page(const TiledTexture &tex, ImVec2 size);
+static void begin_page_draws();
+static void show_stats(const Reader &r, bool *p_open);
+
+static Histogram &frame_us = stats().histogram("frame_us");
+static Histogram &frame_cpu_us = stats().histogram("frame_cpu_us");
+static Histogram &upload_bytes = stats().histogram("upload_bytes");
+static Counter &uploading = stats().counter("pages_uploading");
 
 void Reader::init() {
     int chap = 1;
@@ -35,10 +49,37 @@ void Reader::init() {
         info("couldn't find last_chap.txt, defaulting to %d", chap);
     }
 
+    setImageCompression(compress_textures);
+    setGreyscaleDetection(greyscale_pages);
+    setImageMipmaps(mipmap_pages);
+    page_cache.init();
+    if (cache_decoded_pages) {
+        decoded_cache.init("cache/decoded", decoded_cache_size, "rgba");
+    }
+    downloader.init(&page_cache, cache_decoded_pages ? &decoded_cache : nullptr);
+    residency.init(restore_scan, this);
+    thumbs.init();
+    spanThreadName("main");
+    downloader.set_thumbnails(thumbnail_height);
+    layout.gap = page_gap;
+
     load_images(chap);
 }
 
 void Reader::close() {
+    downloader.cancel();
+    downloader.shutdown();
+    for (auto &up : uploads) {
+        freeTiledTexture(up.tex);
+        freeImage(up.page.img);
+        freeImage(up.page.thumb);
+    }
+    uploads.clear();
+    thumbs.shutdown();
+    page_cache.save();
+    decoded_cache.save();
+    http::shutdown();
+
     int chap_id = scans[cur_scan].chap_id;
     int chap = chapters[chap_id].number;
 
@@ -58,50 +99,40 @@ void Reader::load_images(int chapter) {
         }
     }
 
-    chapters.append({ chapter, 0 });
+    int chap_id = 0;
+    {
+        std::lock_guard<std::mutex> lock(images_mtx);
+        chapters.append({ chapter, 0, {} });
+        chap_id = (int)chapters.len - 1;
+    }
 
     still_loading = true;
 
+    // only fetches the list of pages, prefetch() requests them
     std::thread load(
-        [this, chapter](){
+        [this, chapter, chap_id](){
             info("loading images from chapter: %d", chapter);
-            system(format("python3 get_images.py %d", chapter));
-            vec<str_view> images_url = split_lines(
-                read_whole_file(format("cache/chap-%d.txt", chapter))
-            );
-
-            int page_num = 0;
-            int chap_id = chapters.len - 1;
-
-            images.resize(images.len + images_url.len);
-            pages_count = (int)images.len;
-            chapters[chap_id].length = images_url.len;
-
-            for (const auto &img : images_url) {
-                if (should_stop) {
-                    should_stop = false;
-                    still_loading = false;
-                    return;
-                }
-                
-                str_view hostname = img.sub(8, 25);
-                str_view uri = img.sub(25);
-
-                auto res = http::get(hostname, uri).unpack();
-                if (res.status != http::STATUS_OK) {
-                    err("req failed: %d", (int)res.status);
-                    err("data:\n%s", res.data.buf);
-                }
-                else {
-                    images[loaded_count++] = {
-                        loadImageFromMemory(res.data.buf, res.data.len),
-                        ++page_num,
-                        chap_id
-                    };
+            char index_file[64];
+            snprintf(index_file, sizeof(index_file), "cache/chap-%d.txt", chapter);
+            // the list of pages never changes, only fetch it once
+            if (!fileExists(index_file) && !fetch_chapter_index(chapter, index_file)) {
+                err("couldn't get the pages of chapter %d, it stays empty", chapter);
+            }
+            str urls = read_whole_file(index_file);
+            vec<str_view> images_url = split_lines(urls);
+
+            {
+                std::lock_guard<std::mutex> lock(images_mtx);
+                images.reserve(images_url.len);
+                for (usize i = 0; i < images_url.len; ++i) {
+                    images.append({ {}, 0, 0, 0, (int)i + 1, chap_id, IMG_WAITING, images_url[i], -1 });
                 }
+                pages_count = (int)images.len;
+                chapters[chap_id].length = (int)images_url.len;
+                chapters[chap_id].urls = urls;
             }
 
-            info("finished loading images from chapter: %d", chapter);
+            info("found %d pages in chapter: %d", (int)images_url.len, chapter);
             still_loading = false;
         }
     );
@@ -109,23 +140,102 @@ void Reader::load_images(int chapter) {
 }
 
 void Reader::frame() {
-    int local_count = loaded_count;
-    while (scans.len < local_count) {
-        usize i = scans.len;
-        auto tex = loadTextureFromImage(images[i].img);
-        ImVec2 sz = { (f32)images[i].img.width, (f32)images[i].img.height };
-        scans.append({tex, sz, 1.f, images[i].page_num, images[i].chap_id});
-        freeImage(images[i].img);
-    }
-
-    for (int i = cur_scan - 30; i >= 0; --i) {
-        auto &s = scans[i];
-        if (s.tex.id != 0) {
-            freeTexture(s.tex);
-            s.tex.id = 0;
+    // time between frames, then the time spent in here
+    static u64 last_frame = 0;
+    if (last_frame) frame_us.record((u64)stm_us(stm_since(last_frame)));
+    last_frame = stm_now();
+    ScopedTimer frame_timer(frame_cpu_us);
+    SPAN("Reader::frame");
+
+    {
+        SPAN("uploads");
+        std::lock_guard<std::mutex> lock(images_mtx);
+
+        // last stage of the loading pipeline, the pages closest to the reader
+        // are uploaded first and the ones over the budget wait for the next frame.
+        // we never hold more than a queue worth of them so the decoders still stall
+        LoadedPage page;
+        while (uploads.len < upload_queue_len && downloader.pop_loaded(page)) {
+            uploads.append({ page, {}, 0.0 });
+        }
+
+        usize focus = focus_slot();
+        u64 start = stm_now();
+        usize frame_bytes = 0;
+        while (uploads.len > 0) {
+            usize nearest = 0;
+            usize nearest_dist = (usize)-1;
+            for (usize i = 0; i < uploads.len; ++i) {
+                usize slot = (usize)uploads[i].page.job.slot;
+                usize dist = slot >= focus ? slot - focus : focus - slot;
+                if (dist < nearest_dist) {
+                    nearest = i;
+                    nearest_dist = dist;
+                }
+            }
+
+            auto &up = uploads[nearest];
+            u64 page_start = stm_now();
+            bool done = true;
+            if (up.page.success) {
+                if (!up.tex.tiles) {
+                    up.tex = makeTiledTexture(up.page.img);
+                }
+                // pages too big for one texture go a tile at a time, they
+                // carry on in the next frame when they run out of budget
+                int before = up.tex.uploaded;
+                do {
+                    done = uploadTextureTiles(&up.tex, up.page.img, 1);
+                } while (!done && stm_ms(stm_since(start)) < upload_budget_ms);
+                int tiles = up.tex.cols * up.tex.rows;
+                frame_bytes += imageDataSize(up.page.img) * (usize)(up.tex.uploaded - before) / (usize)(tiles > 0 ? tiles : 1);
+            }
+            up.upload_ms += stm_ms(stm_since(page_start));
+
+            if (done) {
+                downloader.upload_done(up.upload_ms);
+                upload_page(up.page, up.tex);
+                uploads.remove(nearest);
+            }
+
+            if (stm_ms(stm_since(start)) >= upload_budget_ms) break;
+        }
+        // the thumbnails that arrived lately in one upload per atlas, not
+        // more often than atlas_flush_interval_ms
+        thumbs.flush();
+        upload_bytes.record(frame_bytes);
+        uploading.set((i64)(uploads.len + downloader.upload_queued()));
+
+        // pages can finish in any order, but they are shown in page order
+        while (next_image < images.len && images[next_image].state >= IMG_READY) {
+            usize slot = next_image++;
+            auto &img = images[slot];
+            if (img.state == IMG_FAILED) continue;
+
+            ImVec2 sz = { (f32)img.width, (f32)img.height };
+            if (img.state == IMG_SKIPPED) {
+                // the real size is only known once it's loaded, most pages
+                // are the same size as the one before them
+                sz = scans.len > 0 ? scans.back().size : ImVec2(placeholder_width, placeholder_height);
+                img.bytes = scans.len > 0 ? scans.back().bytes : (usize)(sz.x * sz.y);
+                img.tex = {};
+            }
+            else if (img.chap_id == jump_to_chap) {
+                cur_scan = (int)scans.len;
+                jump_to_chap = -1;
+            }
+
+            img.scan = (int)scans.len;
+            scans.append({img.tex, sz, 1.f, img.page_num, img.chap_id, slot, img.bytes, false});
+            layout.append((double)sz.y / (double)sz.x);
+            residency.added(scans);
         }
+
+        residency.update(scans, (usize)cur_scan);
     }
 
+    prefetch();
+
     if (need_to_load && !still_loading) {
         need_to_load = false;
         load_images(chap_to_load);
@@ -136,6 +246,66 @@ void Reader::frame() {
         sapp_toggle_fullscreen();
     }
 
+    if (ImGui::IsKeyPressed(ImGuiKey_L, false)) {
+        show_loader_stats = !show_loader_stats;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_D, false)) {
+        char filename[64];
+        snprintf(filename, sizeof(filename), "cache/trace-%lld.json", (long long)time(nullptr));
+        spanDump(filename);
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_S, false)) {
+        show_perf = !show_perf;
+    }
+    if (show_perf) {
+        show_stats(*this, &show_perf);
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_T, false)) {
+        show_thumbs = !show_thumbs;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_V, false)) {
+        continuous = !continuous;
+        // start from the top of the page being read
+        layout_scan = -1;
+    }
+    if (show_loader_stats) {
+        StageStats stats[STAGE_COUNT];
+        downloader.get_stats(stats);
+
+        ImGui::Begin("Loader", &show_loader_stats, ImGuiWindowFlags_AlwaysAutoResize);
+        if (ImGui::BeginTable("stages", 5)) {
+            ImGui::TableSetupColumn("Stage");
+            ImGui::TableSetupColumn("Queued");
+            ImGui::TableSetupColumn("Done");
+            ImGui::TableSetupColumn("Wait (ms)");
+            ImGui::TableSetupColumn("Work (ms)");
+            ImGui::TableHeadersRow();
+            for (auto &s : stats) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(s.name);
+                ImGui::TableNextColumn();
+                if (s.capacity) ImGui::Text("%d/%d", s.depth, s.capacity);
+                else            ImGui::Text("%d", s.depth);
+                ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)s.done);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", s.avg_wait_ms);
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", s.avg_work_ms);
+            }
+            ImGui::EndTable();
+        }
+        ImGui::SliderInt("Prefetch window", &prefetch_window, 1, 200);
+        ImGui::SliderFloat("Upload budget (ms)", &upload_budget_ms, 0.5f, 16.f);
+        ImGui::Text("Uploads waiting: %d", (int)uploads.len);
+        ImGui::Text(
+            "Textures: %.0f/%.0f MB, pages %d-%d",
+            residency.resident / (1024.0 * 1024.0),
+            residency.budget / (1024.0 * 1024.0),
+            (int)residency.lo, (int)residency.hi
+        );
+        ImGui::Text("Page cache: %llu hits, %llu misses", (unsigned long long)page_cache.hits, (unsigned long long)page_cache.misses);
+        ImGui::Text("Decoded cache: %llu hits, %llu misses", (unsigned long long)decoded_cache.hits, (unsigned long long)decoded_cache.misses);
+        ImGui::End();
+    }
+
     static bool show_chap_select = false;
     if (ImGui::IsKeyPressed(ImGuiKey_C, false)) {
         show_chap_select = true;
@@ -146,22 +316,26 @@ void Reader::frame() {
         ImGui::Begin("Chapter Select", &show_chap_select);
             ImGui::InputInt("Chapter", &chap, 0);
             if (ImGui::Button("Go")) {
-                chap_to_load = chap;
-                need_to_load = true;
-                should_stop = true;
-                cur_scan = loaded_count;
+                jump_to(chap);
             }
         ImGui::End();
     }
 
     init_dock();
+    draw_thumbnails();
 
-    if (cur_scan >= scans.len) return;
+    if ((usize)cur_scan >= scans.len) return;
 
-    ImGui::Begin("Reader", nullptr, ImGuiWindowFlags_NoScrollWithMouse);
+    ImGuiWindowFlags reader_flags = ImGuiWindowFlags_NoScrollWithMouse;
+    // the column scrolls on its own, ImGui only ever sees the visible pages
+    if (continuous) reader_flags |= ImGuiWindowFlags_NoScrollbar;
+    ImGui::Begin("Reader", nullptr, reader_flags);
         auto &scan = scans[cur_scan];
-        if (scan.tex.id != 0) {
-            auto id = (ImTextureID)((uintptr_t)scan.tex.id);
+        begin_page_draws();
+        if (continuous) {
+            draw_continuous();
+        }
+        else if (scan.tex.tiles) {
             ImVec2 size = scan.size;
             ImVec2 winsize = ImGui::GetWindowSize();
 
@@ -177,7 +351,7 @@ void Reader::frame() {
 
             size *= scan.mul;
             ImGui::SetCursorPos((winsize - size) * 0.5f + offset);
-            ImGui::Image(id, size);
+            draw_page(scan.tex, size);
         }
     ImGui::End();
 
@@ -191,6 +365,9 @@ void Reader::frame() {
         show_pagenum = true;
     }
 
+    // scrolling and zoom are handled by draw_continuous
+    if (continuous) return;
+
     auto was_scan = cur_scan;
 
     if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow, false)) {
@@ -198,16 +375,6 @@ void Reader::frame() {
     }
     if (ImGui::IsKeyPressed(ImGuiKey_RightArrow, false)) {
         cur_scan = min(cur_scan + 1, scans.len - 1);
-        if (!still_loading) {
-            auto &scan = scans[cur_scan];
-            auto &chap = chapters[scan.chap_id];
-
-            // if theres only 8 pages left to read
-            if (scan.page_num >= (chap.length - 8)) {
-                chap_to_load = chap.number + 1;
-                need_to_load = true;
-            }
-        }
     }
 
     if (was_scan != cur_scan) {
@@ -232,6 +399,307 @@ void Reader::frame() {
     }
 }
 
+// called inside the Reader window
+void Reader::draw_continuous() {
+    ImVec2 winsize = ImGui::GetWindowSize();
+    double width = winsize.x * column_zoom;
+    double view = winsize.y;
+
+    // the page changed from somewhere else (arrows, a jump, a mode switch)
+    if (layout_scan != cur_scan) {
+        scroll = layout.top((usize)cur_scan, width);
+    }
+
+    if (ImGui::IsWindowHovered()) {
+        scroll -= ImGui::GetIO().MouseWheel * wheel_scroll;
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_DownArrow)) scroll += view * 0.2;
+    if (ImGui::IsKeyPressed(ImGuiKey_UpArrow))   scroll -= view * 0.2;
+    if (ImGui::IsKeyPressed(ImGuiKey_PageDown))  scroll += view * 0.9;
+    if (ImGui::IsKeyPressed(ImGuiKey_PageUp))    scroll -= view * 0.9;
+    if (ImGui::IsKeyPressed(ImGuiKey_RightArrow, false) && cur_scan + 1 < (int)scans.len) {
+        scroll = layout.top((usize)cur_scan + 1, width);
+    }
+    if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow, false) && cur_scan > 0) {
+        scroll = layout.top((usize)cur_scan - 1, width);
+    }
+    if (ImGui::IsMouseDragging(ImGuiMouseButton_Right)) {
+        scroll -= ImGui::GetIO().MouseDelta.y;
+    }
+
+    // zoom around the middle of the window, positions scale with the width
+    float zoom = 1.f;
+    if (ImGui::IsKeyPressed(ImGuiKey_RightBracket, false)) zoom = 1.2f;
+    if (ImGui::IsKeyPressed(ImGuiKey_Slash, false))        zoom = 0.8f;
+    if (zoom != 1.f) {
+        column_zoom *= zoom;
+        scroll = (scroll + view * 0.5) * zoom - view * 0.5;
+        width = winsize.x * column_zoom;
+    }
+
+    double max_scroll = layout.total(width) - view;
+    if (scroll > max_scroll) scroll = max_scroll;
+    if (scroll < 0.0) scroll = 0.0;
+
+    // only the pages overlapping the window are touched
+    float x = (float)(winsize.x - width) * 0.5f;
+    for (usize i = layout.page_at(scroll, width); i < layout.count(); ++i) {
+        double top = layout.top(i, width) - scroll;
+        if (top >= view) break;
+
+        if (scans[i].tex.tiles) {
+            ImGui::SetCursorPos({ x, (float)top });
+            draw_page(scans[i].tex, { (float)width, (float)layout.height(i, width) });
+        }
+    }
+
+    cur_scan = (int)layout.page_at(scroll + view * 0.5, width);
+    layout_scan = cur_scan;
+}
+
+// overview of every page we know of, a grid of fixed size cells. only the
+// visible rows are touched and the thumbnails go in their own channel, so
+// the ones sharing an atlas end up in a single draw call
+void Reader::draw_thumbnails() {
+    if (!show_thumbs) return;
+
+    if (!ImGui::Begin("Pages", &show_thumbs)) {
+        ImGui::End();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(images_mtx);
+
+    ImGuiStyle &style = ImGui::GetStyle();
+    ImVec2 cell = { thumb_cell_width, thumb_cell_height };
+    float row_height = cell.y + style.ItemSpacing.y;
+    float avail = ImGui::GetContentRegionAvail().x;
+    int columns = max((int)((avail + style.ItemSpacing.x) / (cell.x + style.ItemSpacing.x)), 1);
+    int rows = ((int)images.len + columns - 1) / columns;
+
+    usize current = (usize)-1;
+    if ((usize)cur_scan < scans.len) current = scans[cur_scan].slot;
+    if (current != thumbs_slot && current != (usize)-1) {
+        thumbs_slot = current;
+        float y = (float)(current / columns) * row_height;
+        float view = ImGui::GetWindowHeight();
+        if (y < ImGui::GetScrollY() || y + row_height > ImGui::GetScrollY() + view) {
+            ImGui::SetScrollY(y - (view - row_height) * 0.5f);
+        }
+    }
+
+    ImDrawList *list = ImGui::GetWindowDrawList();
+    list->ChannelsSplit(2);
+
+    ImGuiListClipper clipper;
+    clipper.Begin(rows, row_height);
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            for (int col = 0; col < columns; ++col) {
+                usize slot = (usize)(row * columns + col);
+                if (slot >= images.len) break;
+                if (col > 0) ImGui::SameLine();
+
+                ImGui::PushID((int)slot);
+                ImVec2 pos = ImGui::GetCursorScreenPos();
+                bool clicked = ImGui::InvisibleButton("thumb", cell);
+                bool hovered = ImGui::IsItemHovered();
+                ImGui::PopID();
+
+                const auto &img = images[slot];
+                const Thumb &thumb = thumbs.get(slot);
+                if (thumb.tex.id) {
+                    float scale = ImMin(cell.x / thumb.size.x, cell.y / thumb.size.y);
+                    ImVec2 size = thumb.size * scale;
+                    ImVec2 top_left = pos + (cell - size) * 0.5f;
+                    list->ChannelsSetCurrent(0);
+                    list->AddImage((ImTextureID)((uintptr_t)thumb.tex.id), top_left, top_left + size, thumb.uv0, thumb.uv1);
+                }
+                else {
+                    list->ChannelsSetCurrent(1);
+                    list->AddRectFilled(pos, pos + cell, ImGui::GetColorU32(ImGuiCol_FrameBg));
+                }
+
+                if (slot == current || hovered) {
+                    list->ChannelsSetCurrent(1);
+                    ImGuiCol col_id = slot == current ? ImGuiCol_CheckMark : ImGuiCol_ButtonHovered;
+                    list->AddRect(pos, pos + cell, ImGui::GetColorU32(col_id), 0.f, 0, 2.f);
+                }
+
+                if (hovered) {
+                    ImGui::SetTooltip("Chapter %d, page %d", chapters[img.chap_id].number, img.page_num);
+                }
+                // pages that aren't shown yet have nowhere to go
+                if (clicked && img.scan >= 0) {
+                    cur_scan = img.scan;
+                }
+            }
+        }
+    }
+
+    list->ChannelsMerge();
+    ImGui::End();
+}
+
+// must be called with images_mtx locked
+void Reader::upload_page(const LoadedPage &page, TiledTexture tex) {
+    auto &img = images[page.job.slot];
+
+    // only pages without a thumbnail ask for one, add() ignores the rest
+    thumbs.add((usize)page.job.slot, page.thumb);
+    freeImage(page.thumb);
+
+    // an evicted page coming back
+    if (img.scan >= 0) {
+        if (page.success) {
+            if (img.state == IMG_SKIPPED) {
+                // a placeholder loaded for the first time
+                Scan &s = scans[img.scan];
+                img.state = IMG_READY;
+                img.width = page.img.width;
+                img.height = page.img.height;
+                img.bytes = imageDataSize(page.img);
+                s.size = { (f32)img.width, (f32)img.height };
+                layout.set((usize)img.scan, (double)img.height / (double)img.width);
+                residency.set_bytes(scans, (usize)img.scan, img.bytes);
+                ++loaded_count;
+            }
+            residency.restored(scans, img.scan, tex);
+            freeImage(page.img);
+        }
+        else {
+            residency.restore_failed(scans, img.scan);
+        }
+        return;
+    }
+
+    img.page_num = page.job.page_num;
+    img.chap_id = page.job.chap_id;
+    // cancelled by a jump, not a failure
+    if (!page.success && page.job.generation != downloader.cur_generation()) {
+        img.state = IMG_SKIPPED;
+        return;
+    }
+    img.state = page.success ? IMG_READY : IMG_FAILED;
+    if (page.success) {
+        img.tex = tex;
+        img.width = page.img.width;
+        img.height = page.img.height;
+        img.bytes = imageDataSize(page.img);
+        freeImage(page.img);
+    }
+    ++loaded_count;
+}
+
+void Reader::restore_scan(usize scan, void *udata) {
+    Reader *self = (Reader *)udata;
+    const Scan &s = self->scans[scan];
+
+    // images_mtx is already locked by frame()
+    self->downloader.push({
+        self->images[s.slot].url,
+        (int)s.slot,
+        s.page_num,
+        s.chap_id,
+        self->downloader.cur_generation(),
+        // restored pages usually have one already
+        !self->thumbs.has(s.slot),
+        0,
+        0
+    });
+}
+
+void Reader::prefetch() {
+    bool need_next_chap = false;
+    int next_chap = 0;
+    {
+        std::lock_guard<std::mutex> lock(images_mtx);
+
+        usize focus = focus_slot();
+        downloader.set_focus(focus);
+
+        usize window_end = focus + (usize)prefetch_window;
+        for (; next_request < images.len && next_request <= window_end; ++next_request) {
+            auto &img = images[next_request];
+            if (img.state != IMG_WAITING) continue;
+
+            img.state = IMG_PENDING;
+            downloader.push({
+                img.url,
+                (int)next_request,
+                img.page_num,
+                img.chap_id,
+                downloader.cur_generation(),
+                !thumbs.has(next_request),
+                0,
+                0
+            });
+        }
+        // the window goes past the last page we know of. the loader thread
+        // sets the length of a chapter under images_mtx
+        if (window_end >= images.len && chapters.len > 0) {
+            const auto &last = chapters.back();
+            // an empty chapter means it doesn't exist (yet), don't go any further
+            need_next_chap = last.length > 0;
+            next_chap = last.number + 1;
+        }
+    }
+
+    if (need_next_chap && !still_loading && !need_to_load) {
+        chap_to_load = next_chap;
+        need_to_load = true;
+    }
+}
+
+usize Reader::focus_slot() {
+    if (jump_to_chap == -1 && (usize)cur_scan < scans.len) {
+        return scans[cur_scan].slot;
+    }
+    // while jumping the reader is waiting for the first page of the new
+    // chapter, it goes before anything else as soon as its slots exist
+    if (jump_to_chap != -1) {
+        for (usize i = next_image; i < images.len; ++i) {
+            if (images[i].chap_id == jump_to_chap) {
+                return i;
+            }
+        }
+    }
+    return next_image;
+}
+
+void Reader::jump_to(int chapter) {
+    for (usize id = 0; id < chapters.len; ++id) {
+        if (chapters[id].number != chapter) continue;
+
+        // already loaded, go to its first page or wait for it
+        for (usize i = 0; i < scans.len; ++i) {
+            if (scans[i].chap_id == (int)id) {
+                cur_scan = (int)i;
+                return;
+            }
+        }
+        jump_to_chap = (int)id;
+        return;
+    }
+
+    // whatever was prefetched after the current page isn't needed now,
+    // it's skipped and loaded again if the reader comes back to it
+    downloader.cancel();
+    {
+        std::lock_guard<std::mutex> lock(images_mtx);
+        for (usize i = next_image; i < images.len; ++i) {
+            if (images[i].state == IMG_WAITING) {
+                images[i].state = IMG_SKIPPED;
+            }
+        }
+        next_request = images.len;
+    }
+
+    chap_to_load = chapter;
+    need_to_load = true;
+    jump_to_chap = (int)chapters.len;
+}
+
 static void init_dock() {
     // We are using the ImGuiWindowFlags_NoDocking flag to make the parent window not dockable into,
     // because it would be confusing to have two docking targets within each others.
@@ -270,8 +738,13 @@ static void init_dock() {
             ImGui::DockBuilderAddNode(dockspace_id, ImGuiDockNodeFlags_DockSpace);
             ImGui::DockBuilderSetNodeSize(dockspace_id, viewport->Size);
 
+            ImGuiID pages_id = 0;
+            ImGuiID reader_id = 0;
+            ImGui::DockBuilderSplitNode(dockspace_id, ImGuiDir_Left, 0.2f, &pages_id, &reader_id);
+
             // we now dock our windows into the docking node we made above
-            ImGui::DockBuilderDockWindow("Reader", dockspace_id);
+            ImGui::DockBuilderDockWindow("Pages", pages_id);
+            ImGui::DockBuilderDockWindow("Reader", reader_id);
             ImGui::DockBuilderFinish(dockspace_id);
         }
     }
@@ -313,4 +786,131 @@ static void show_page_num(int page_num, int chap_num, bool *p_open) {
         }
     }
     ImGui::End();
-}
\ No newline at end of file
+}
+
+static void percentile_row(const char *label, const Histogram *hist, double scale, const char *fmt) {
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn(); ImGui::TextUnformatted(label);
+    double ps[] = { 0.5, 0.95, 0.99 };
+    for (double p : ps) {
+        ImGui::TableNextColumn();
+        ImGui::Text(fmt, hist ? hist->percentile(p) * scale : 0.0);
+    }
+}
+
+static double hit_rate(const PageCache &cache) {
+    u64 hits = cache.hits;
+    u64 total = hits + cache.misses;
+    return total ? 100.0 * hits / total : 0.0;
+}
+
+// in the corner opposite to the page count, most of what tuning the
+// prefetch window needs
+static void show_stats(const Reader &r, bool *p_open) {
+    const float PAD = 10.0f;
+    const ImGuiViewport *viewport = ImGui::GetMainViewport();
+    ImVec2 pos = { viewport->WorkPos.x + viewport->WorkSize.x - PAD, viewport->WorkPos.y + PAD };
+    ImGui::SetNextWindowPos(pos, ImGuiCond_Always, { 1.f, 0.f });
+    ImGui::SetNextWindowViewport(viewport->ID);
+    ImGui::SetNextWindowBgAlpha(0.35f);
+
+    ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoMove;
+    if (ImGui::Begin("Stats", p_open, window_flags)) {
+        Stats &s = stats();
+        if (ImGui::BeginTable("percentiles", 4)) {
+            ImGui::TableSetupColumn("");
+            ImGui::TableSetupColumn("p50");
+            ImGui::TableSetupColumn("p95");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableHeadersRow();
+            percentile_row("Frame (ms)", s.find_histogram("frame_us"), 1e-3, "%.2f");
+            percentile_row("Frame cpu (ms)", s.find_histogram("frame_cpu_us"), 1e-3, "%.2f");
+            percentile_row("Uploaded (KB)", s.find_histogram("upload_bytes"), 1.0 / 1024.0, "%.0f");
+            percentile_row("Fetch (ms)", s.find_histogram("fetch_us"), 1e-3, "%.1f");
+            percentile_row("Decode (ms)", s.find_histogram("decode_us"), 1e-3, "%.1f");
+            ImGui::EndTable();
+        }
+
+        Counter *stages[] = { s.find_counter("pages_fetching"), s.find_counter("pages_decoding"), s.find_counter("pages_uploading") };
+        ImGui::Text(
+            "In flight: %d fetch, %d decode, %d upload",
+            stages[0] ? (int)stages[0]->get() : 0,
+            stages[1] ? (int)stages[1]->get() : 0,
+            stages[2] ? (int)stages[2]->get() : 0
+        );
+        ImGui::Text("Cache hits: %.0f%% pages, %.0f%% decoded", hit_rate(r.page_cache), hit_rate(r.decoded_cache));
+
+        if (ImGui::BeginPopupContextWindow()) {
+            if (ImGui::MenuItem("Reset")) s.reset_histograms();
+            if (p_open && ImGui::MenuItem("Close")) *p_open = false;
+            ImGui::EndPopup();
+        }
+    }
+    ImGui::End();
+}
+
+constexpr int max_grey_tiles = 64;
+
+struct grey_tile {
+    Texture tex;
+    ImVec2 min;
+    ImVec2 max;
+};
+
+// they have to live until ImGui renders, reset every frame
+static grey_tile grey_tiles[max_grey_tiles];
+static int grey_tile_count = 0;
+
+static void grey_tile_callback(const ImDrawList *list, const ImDrawCmd *cmd) {
+    (void)list;
+    auto tile = (const grey_tile *)cmd->UserCallbackData;
+    ImVec2 screen = ImGui::GetIO().DisplaySize;
+    ImVec4 clip = cmd->ClipRect;
+    drawTextureImmediate(
+        tile->tex,
+        { tile->min.x, tile->min.y, tile->max.x - tile->min.x, tile->max.y - tile->min.y },
+        { clip.x, clip.y, clip.z - clip.x, clip.w - clip.y },
+        { screen.x, screen.y },
+        sapp_dpi_scale()
+    );
+}
+
+static void begin_page_draws() {
+    grey_tile_count = 0;
+}
+
+// draws the page at the cursor, only the tiles that are inside the window.
+// ImGui's shader samples every texture as rgba, single channel tiles would
+// come out red, so they are drawn by the framework from inside the ImGui pass
+static void draw_page(const TiledTexture &tex, ImVec2 size) {
+    ImVec2 pos = ImGui::GetCursorScreenPos();
+    ImGui::Dummy(size);
+
+    ImDrawList *list = ImGui::GetWindowDrawList();
+    ImVec2 clip_min = list->GetClipRectMin();
+    ImVec2 clip_max = list->GetClipRectMax();
+    ImVec2 scale = size / ImVec2((f32)tex.width, (f32)tex.height);
+
+    for (int row = 0; row < tex.rows; ++row) {
+        for (int col = 0; col < tex.cols; ++col) {
+            Rect rect = tiledTextureTileRect(tex, col, row);
+            ImVec2 min = pos + ImVec2(rect.x, rect.y) * scale;
+            ImVec2 max = min + ImVec2(rect.w, rect.h) * scale;
+            if (max.x < clip_min.x || min.x > clip_max.x || max.y < clip_min.y || min.y > clip_max.y) {
+                continue;
+            }
+
+            Texture tile = tiledTextureTile(tex, col, row);
+            if (tile.id == 0) continue;
+
+            if (!tile.grey) {
+                list->AddImage((ImTextureID)((uintptr_t)tile.id), min, max);
+            }
+            else if (grey_tile_count < max_grey_tiles) {
+                grey_tile *data = &grey_tiles[grey_tile_count++];
+                *data = { tile, min, max };
+                list->AddCallback(grey_tile_callback, data);
+            }
+        }
+    }
+}
@@ -2,6 +2,7 @@
 
 #include <thread>
 #include <atomic>
+#include <mutex>
 
 #include <imgui.h>
 
@@ -10,25 +11,79 @@
 
 #include "framework/framework.h"
 
-constexpr int ring_size = 200;
+#include "loader.h"
+#include "page_cache.h"
+#include "residency.h"
+#include "page_layout.h"
+#include "thumb_atlas.h"
+
+// decoded pages are ~4 bytes per pixel, so this fills up a lot faster
+// than the page cache
+constexpr bool cache_decoded_pages = true;
+constexpr usize decoded_cache_size = 4ull * 1024 * 1024 * 1024;
+// BC1 pages take 1/8 of the memory of RGBA8 ones, both on the gpu and in
+// the decoded cache, for a small loss in quality
+constexpr bool compress_textures = true;
+// greyscale pages are kept with a single channel, 1/4 of the memory of
+// RGBA8 ones (or 1/2 of BC1 ones when compressed)
+constexpr bool greyscale_pages = true;
+// pages are almost always drawn smaller than they are, mips keep them from
+// aliasing for 1/3 more memory
+constexpr bool mipmap_pages = true;
+
+constexpr int default_prefetch_window = 24;
+// time spent uploading textures in a frame, at least one page is always uploaded
+constexpr float default_upload_budget_ms = 4.f;
+// continuous mode, space between pages and how far a wheel notch scrolls
+constexpr float page_gap = 8.f;
+constexpr float wheel_scroll = 120.f;
+// thumbnails are made this tall on the decode workers and drawn in cells
+// of this size in the overview
+constexpr int thumbnail_height = 128;
+constexpr float thumb_cell_width = 64.f;
+constexpr float thumb_cell_height = 96.f;
+// size given to a skipped page when there's no page before it to copy
+constexpr float placeholder_width = 1000.f;
+constexpr float placeholder_height = 1500.f;
+
+enum LoadedState {
+    // known but not requested yet
+    IMG_WAITING,
+    IMG_PENDING,
+    IMG_READY,
+    IMG_FAILED,
+    // left behind (or cancelled) by a jump, it's shown as a placeholder and
+    // loaded like an evicted page once the reader gets back to it
+    IMG_SKIPPED,
+};
 
 struct LoadedImg {
-    Image img;
+    // uploaded as soon as it's decoded, even if the pages before it aren't
+    TiledTexture tex;
+    int width, height;
+    usize bytes;
     int page_num;
     int chap_id;
+    LoadedState state;
+    // points into the chapter's url list
+    str_view url;
+    // index in scans once it's shown, -1 before
+    int scan;
 };
 
-struct Scan {
-    Texture tex;
-    ImVec2 size;
-    float mul = 1.f;
-    int page_num;
-    int chap_id;
+// a decoded page waiting for the main thread, big pages can take a few
+// frames to upload all their tiles
+struct PageUpload {
+    LoadedPage page;
+    TiledTexture tex;
+    double upload_ms;
 };
 
 struct Chapter {
     int number;
     int length;
+    // content of cache/chap-N.txt, the download jobs point into it
+    str urls;
 };
 
 struct Reader {
@@ -36,21 +91,63 @@ struct Reader {
     void close();
     void load_images(int chapter);
     void frame();
+    void prefetch();
+    usize focus_slot();
+    void upload_page(const LoadedPage &page, TiledTexture tex);
+    void jump_to(int chapter);
+    void draw_continuous();
+    void draw_thumbnails();
+
+    static void restore_scan(usize scan, void *udata);
 
     std::atomic<int> loaded_count;
     std::atomic<int> pages_count;
-    std::atomic<bool> should_stop = false;
     std::atomic<bool> still_loading = false;
 
     int cur_scan = 0;
     bool need_to_load = false;
     int chap_to_load = 0;
+    // chapter to jump to as soon as its first page is uploaded, -1 for none
+    int jump_to_chap = -1;
+    // how many pages ahead of the current one are requested, the next
+    // chapter is loaded as soon as the window goes past the last page
+    int prefetch_window = default_prefetch_window;
+    float upload_budget_ms = default_upload_budget_ms;
+
+    Downloader downloader;
+    PageCache page_cache;
+    PageCache decoded_cache;
+    TextureResidency residency;
+    ThumbAtlas thumbs;
 
+    // filled out of order as the pages finish, shown in page order
+    std::mutex images_mtx;
     vec<LoadedImg> images;
+    usize next_image = 0;
+    // every slot before this one was already requested
+    usize next_request = 0;
+    // decoded pages that didn't fit in the upload budget of their frame
+    vec<PageUpload> uploads;
+
     vec<Scan> scans;
     vec<Chapter> chapters;
 
+    // continuous mode lays out every scan in a column and scrolls through
+    // them, cur_scan follows the page in the middle of the window
+    bool continuous = false;
+    PageLayout layout;
+    // top of the window in layout space, at the current page width
+    double scroll = 0.0;
+    float column_zoom = 1.f;
+    // cur_scan as last set by the continuous mode, to notice jumps
+    int layout_scan = -1;
+
     ImVec2 offset;
+    bool show_loader_stats = false;
+    bool show_perf = false;
+    bool show_thumbs = true;
+    // slot the overview last scrolled to, it follows the reader
+    usize thumbs_slot = (usize)-1;
 };
 
 extern Reader reader;
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "residency.h"
+
+void TextureResidency::init(restore_cb callback, void *udata, usize budget_bytes) {
+    on_restore = callback;
+    userdata = udata;
+    budget = budget_bytes;
+    resident = 0;
+    lo = 0;
+    hi = 0;
+    stale.clear();
+    retries.clear();
+    frame = 0;
+}
+
+void TextureResidency::evict(Scan &scan) {
+    if (scan.tex.tiles) {
+        freeTiledTexture(scan.tex);
+        scan.tex.tiles = nullptr;
+    }
+    // if it's being restored, the texture is dropped once it arrives
+    scan.restoring = false;
+    resident -= scan.bytes;
+}
+
+void TextureResidency::include(Scan &scan, usize index) {
+    if (!scan.tex.tiles && !scan.restoring) {
+        scan.restoring = true;
+        on_restore(index, userdata);
+    }
+    resident += scan.bytes;
+}
+
+void TextureResidency::added(vec<Scan> &scans) {
+    usize index = scans.len - 1;
+    Scan &scan = scans[index];
+
+    // only keep it if the window already reaches the end and it fits,
+    // otherwise it will be restored once the reader gets close
+    if (index == hi && fits(scan)) {
+        include(scan, index);
+        ++hi;
+    }
+    else {
+        freeTiledTexture(scan.tex);
+        scan.tex.tiles = nullptr;
+    }
+}
+
+usize TextureResidency::counted(usize scan) const {
+    usize count = in_window(scan) ? 1 : 0;
+    for (const range &r : stale) {
+        if (scan >= r.lo && scan < r.hi) ++count;
+    }
+    return count;
+}
+
+void TextureResidency::set_bytes(vec<Scan> &scans, usize scan, usize bytes) {
+    usize count = counted(scan);
+    resident = resident - scans[scan].bytes * count + bytes * count;
+    scans[scan].bytes = bytes;
+}
+
+void TextureResidency::restored(vec<Scan> &scans, usize scan, TiledTexture tex) {
+    Scan &s = scans[scan];
+    if (in_window(scan) && s.restoring && !s.tex.tiles) {
+        s.tex = tex;
+        s.restoring = false;
+    }
+    else {
+        // evicted again while it was loading
+        freeTiledTexture(tex);
+    }
+}
+
+void TextureResidency::restore_failed(vec<Scan> &scans, usize scan) {
+    scans[scan].restoring = false;
+    // failed or cancelled by a jump, ask again later if it's still needed
+    if (in_window(scan)) {
+        retries.append({ scan, frame + residency_retry_frames });
+    }
+}
+
+void TextureResidency::drop_stale(vec<Scan> &scans, int steps) {
+    while (steps > 0 && stale.len > 0) {
+        range &r = stale.back();
+        usize index = --r.hi;
+        if (r.lo == r.hi) stale.remove(stale.len - 1);
+
+        if (in_window(index)) {
+            // the new window took it over and counts it itself
+            resident -= scans[index].bytes;
+        }
+        else {
+            evict(scans[index]);
+            --steps;
+        }
+    }
+}
+
+int TextureResidency::retry_restores(vec<Scan> &scans, int steps) {
+    for (usize i = 0; i < retries.len && steps > 0;) {
+        retry r = retries[i];
+        if (r.frame > frame) {
+            ++i;
+            continue;
+        }
+        retries.remove(i);
+
+        Scan &scan = scans[r.scan];
+        if (in_window(r.scan) && !scan.tex.tiles && !scan.restoring) {
+            scan.restoring = true;
+            on_restore(r.scan, userdata);
+            --steps;
+        }
+    }
+    return steps;
+}
+
+void TextureResidency::update(vec<Scan> &scans, usize cur) {
+    if (cur >= scans.len) return;
+    ++frame;
+
+    // the reader jumped somewhere else, start over from there and drop the
+    // old window a few scans at a time
+    if (!in_window(cur) && lo != hi) {
+        stale.append({ lo, hi });
+        lo = hi = cur;
+    }
+    if (lo == hi) {
+        lo = hi = cur;
+    }
+
+    int steps = retry_restores(scans, residency_steps_per_frame);
+
+    for (int step = 0; step < steps; ++step) {
+        usize behind = cur - lo;
+        usize ahead = hi - cur;
+        bool can_down = lo > 0;
+        bool can_up = hi < scans.len;
+        if (!can_down && !can_up) break;
+
+        bool grow_up = !can_down || (can_up && ahead <= behind * 2);
+
+        if (grow_up) {
+            if (fits(scans[hi])) {
+                include(scans[hi], hi);
+                ++hi;
+            }
+            // make room by dropping the oldest page behind, if that side is too long
+            else if (behind * 2 > ahead + 1) {
+                evict(scans[lo++]);
+            }
+            else break;
+        }
+        else {
+            if (fits(scans[lo - 1])) {
+                --lo;
+                include(scans[lo], lo);
+            }
+            else if (ahead > behind * 2 + 2) {
+                evict(scans[--hi]);
+            }
+            else break;
+        }
+    }
+
+    // after growing, so the current page is asked for on the frame of the jump
+    drop_stale(scans, residency_drops_per_frame);
+}
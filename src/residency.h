@@ -0,0 +1,85 @@
+#pragma once
+
+#include <imgui.h>
+
+#include "utils/vec.h"
+
+#include "framework/framework.h"
+
+constexpr usize default_texture_budget = 1024ull * 1024 * 1024;
+// evictions and restore requests done by a single update
+constexpr int residency_steps_per_frame = 4;
+// scans of old windows dropped by a single update, apart from the steps
+constexpr int residency_drops_per_frame = 4;
+// a restore that failed or got cancelled is asked again after this many updates
+constexpr u64 residency_retry_frames = 60;
+
+struct Scan {
+    // tiles is null while the texture isn't resident
+    TiledTexture tex;
+    ImVec2 size;
+    float mul = 1.f;
+    int page_num;
+    int chap_id;
+    usize slot;
+    // size of the texture when it's resident
+    usize bytes;
+    // evicted and waiting to be uploaded again
+    bool restoring;
+};
+
+// keeps the textures of a contiguous window of scans [lo, hi) around the
+// current one, about two thirds of it ahead. the window moves one scan at
+// a time, evicting from the far end when the byte budget is full, so every
+// update does a bounded amount of work. after a jump the old window is
+// dropped a few scans per update too, its bytes count until they're gone.
+// scans that come back in the window after being evicted are requested
+// with the restore callback and handed back with restored()
+struct TextureResidency {
+    using restore_cb = void (*)(usize scan, void *udata);
+
+    void init(restore_cb callback, void *udata, usize budget_bytes = default_texture_budget);
+
+    // call after appending a scan, with its texture or without one to have
+    // it restored when it's in the window
+    void added(vec<Scan> &scans);
+    // the size of a scan changed, e.g. a placeholder that got its page
+    void set_bytes(vec<Scan> &scans, usize scan, usize bytes);
+    void restored(vec<Scan> &scans, usize scan, TiledTexture tex);
+    void restore_failed(vec<Scan> &scans, usize scan);
+    void update(vec<Scan> &scans, usize cur);
+
+    usize budget = default_texture_budget;
+    // bytes of every scan in the window, even if it's still being restored,
+    // and of the old windows that aren't dropped yet
+    usize resident = 0;
+    usize lo = 0;
+    usize hi = 0;
+
+private:
+    struct range {
+        usize lo;
+        usize hi;
+    };
+
+    struct retry {
+        usize scan;
+        u64 frame;
+    };
+
+    bool in_window(usize scan) const { return scan >= lo && scan < hi; }
+    bool fits(const Scan &scan) const { return lo == hi || resident + scan.bytes <= budget; }
+    void evict(Scan &scan);
+    void include(Scan &scan, usize index);
+    // how many times the bytes of scan are in resident
+    usize counted(usize scan) const;
+    void drop_stale(vec<Scan> &scans, int steps);
+    int retry_restores(vec<Scan> &scans, int steps);
+
+    // old windows left by jumps, dropped from the end
+    vec<range> stale;
+    vec<retry> retries;
+    u64 frame = 0;
+    restore_cb on_restore = nullptr;
+    void *userdata = nullptr;
+};
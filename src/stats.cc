@@ -0,0 +1,143 @@
+#include "stats.h"
+
+#include <string.h>
+
+#include <sokol_time.h>
+
+#include "tracelog.h"
+
+static int highest_bit(u64 value) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+// values under histogram_sub_buckets get a bucket each, then every power of
+// two is split in histogram_sub_buckets linear steps
+static int bucket_index(u64 value) {
+    if (value < histogram_sub_buckets) return (int)value;
+    int bit = highest_bit(value);
+    int shift = bit - 3;
+    int sub = (int)((value >> shift) & (histogram_sub_buckets - 1));
+    int index = (bit - 2) * histogram_sub_buckets + sub;
+    return index < histogram_buckets ? index : histogram_buckets - 1;
+}
+
+static u64 bucket_low(int index) {
+    if (index < histogram_sub_buckets) return (u64)index;
+    int bit = index / histogram_sub_buckets + 2;
+    u64 sub = (u64)(index % histogram_sub_buckets);
+    return (histogram_sub_buckets + sub) << (bit - 3);
+}
+
+void Histogram::record(u64 value) {
+    buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    u64 cur = largest.load(std::memory_order_relaxed);
+    while (value > cur && !largest.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+}
+
+u64 Histogram::percentile(double p) const {
+    u64 n = count();
+    if (n == 0) return 0;
+
+    u64 target = (u64)(p * (double)n);
+    if (target >= n) target = n - 1;
+
+    u64 seen = 0;
+    for (int i = 0; i < histogram_buckets; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen > target) {
+            u64 low = bucket_low(i);
+            u64 high = i + 1 < histogram_buckets ? bucket_low(i + 1) : low;
+            return low + (high - low) / 2;
+        }
+    }
+    return max();
+}
+
+double Histogram::mean() const {
+    u64 n = count();
+    return n ? (double)sum.load(std::memory_order_relaxed) / (double)n : 0.0;
+}
+
+void Histogram::reset() {
+    for (auto &b : buckets) {
+        b.store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    largest.store(0, std::memory_order_relaxed);
+}
+
+Counter &Stats::counter(const char *name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (int i = 0; i < counter_count; ++i) {
+        if (strcmp(counters[i].name, name) == 0) {
+            return counters[i];
+        }
+    }
+    if (counter_count == stats_max_counters) {
+        fatal("too many counters, can't add %s", name);
+    }
+    counters[counter_count].name = name;
+    return counters[counter_count++];
+}
+
+Histogram &Stats::histogram(const char *name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (int i = 0; i < histogram_count; ++i) {
+        if (strcmp(histograms[i].name, name) == 0) {
+            return histograms[i];
+        }
+    }
+    if (histogram_count == stats_max_histograms) {
+        fatal("too many histograms, can't add %s", name);
+    }
+    histograms[histogram_count].name = name;
+    return histograms[histogram_count++];
+}
+
+Counter *Stats::find_counter(const char *name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (int i = 0; i < counter_count; ++i) {
+        if (strcmp(counters[i].name, name) == 0) {
+            return &counters[i];
+        }
+    }
+    return nullptr;
+}
+
+Histogram *Stats::find_histogram(const char *name) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (int i = 0; i < histogram_count; ++i) {
+        if (strcmp(histograms[i].name, name) == 0) {
+            return &histograms[i];
+        }
+    }
+    return nullptr;
+}
+
+void Stats::reset_histograms() {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (int i = 0; i < histogram_count; ++i) {
+        histograms[i].reset();
+    }
+}
+
+Stats &stats() {
+    static Stats global_stats;
+    return global_stats;
+}
+
+ScopedTimer::ScopedTimer(Histogram &hist) : histogram(hist), start(stm_now()) {}
+
+ScopedTimer::~ScopedTimer() {
+    histogram.record((u64)stm_us(stm_since(start)));
+}
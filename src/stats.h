@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "utils/defines.h"
+
+constexpr int stats_max_counters = 64;
+constexpr int stats_max_histograms = 32;
+// every power of two is split in this many buckets, percentiles are
+// within 1/8 of the real value
+constexpr int histogram_sub_buckets = 8;
+constexpr int histogram_buckets = 62 * histogram_sub_buckets;
+
+// a number that can go up and down, also used for gauges like queue depths
+struct Counter {
+    void add(i64 n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    void set(i64 n) { value.store(n, std::memory_order_relaxed); }
+    i64 get() const { return value.load(std::memory_order_relaxed); }
+
+    const char *name = nullptr;
+    std::atomic<i64> value = 0;
+};
+
+// log scale histogram of u64 values (microseconds, bytes, ...), recording
+// is a few relaxed atomic adds so it can be done from any thread
+struct Histogram {
+    void record(u64 value);
+    // p goes from 0 to 1, returns the middle of the bucket it falls in
+    // or 0 if nothing was recorded
+    u64 percentile(double p) const;
+    u64 count() const { return total.load(std::memory_order_relaxed); }
+    u64 max() const { return largest.load(std::memory_order_relaxed); }
+    double mean() const;
+    // not atomic, samples recorded at the same time can go either way
+    void reset();
+
+    const char *name = nullptr;
+    std::atomic<u64> buckets[histogram_buckets] = {};
+    std::atomic<u64> total = 0;
+    std::atomic<u64> sum = 0;
+    std::atomic<u64> largest = 0;
+};
+
+// named counters and histograms any module can record into. they are
+// looked up by name once and never move, so keep the reference around:
+//     static Histogram &fetch_us = stats().histogram("fetch_us");
+// names must be string literals (or live as long as the program)
+struct Stats {
+    Counter &counter(const char *name);
+    Histogram &histogram(const char *name);
+
+    // null if nobody registered it yet
+    Counter *find_counter(const char *name);
+    Histogram *find_histogram(const char *name);
+
+    void reset_histograms();
+
+private:
+    std::mutex mtx;
+    Counter counters[stats_max_counters];
+    Histogram histograms[stats_max_histograms];
+    int counter_count = 0;
+    int histogram_count = 0;
+};
+
+Stats &stats();
+
+// records the microseconds until the end of the scope
+struct ScopedTimer {
+    ScopedTimer(Histogram &hist);
+    ~ScopedTimer();
+
+    Histogram &histogram;
+    u64 start;
+};
@@ -0,0 +1,104 @@
+#include "thumb_atlas.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// imgui_draw.cpp keeps its own copy static
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imstb_rectpack.h>
+
+#include <sokol_time.h>
+
+#include "tracelog.h"
+
+void ThumbAtlas::init(int side) {
+    size = side;
+}
+
+void ThumbAtlas::shutdown() {
+    for (auto &a : atlases) {
+        freeTexture(a.tex);
+        free(a.pixels);
+        free(a.packer);
+        free(a.nodes);
+    }
+    atlases.clear();
+    thumbs.clear();
+}
+
+ThumbAtlas::atlas &ThumbAtlas::new_atlas() {
+    atlas a = {};
+    a.tex = makeDynamicTexture(size, size);
+    a.pixels = (uchar *)calloc((usize)size * size, 4);
+    a.packer = (stbrp_context *)malloc(sizeof(stbrp_context));
+    a.nodes = (stbrp_node *)malloc(sizeof(stbrp_node) * size);
+    stbrp_init_target(a.packer, size, size, a.nodes, size);
+    atlases.append(a);
+    info("made thumbnail atlas %d", (int)atlases.len);
+    return atlases.back();
+}
+
+bool ThumbAtlas::pack(atlas &a, int width, int height, int *x, int *y) {
+    stbrp_rect rect = {};
+    rect.w = width + atlas_padding * 2;
+    rect.h = height + atlas_padding * 2;
+    stbrp_pack_rects(a.packer, &rect, 1);
+    if (!rect.was_packed) return false;
+    *x = rect.x + atlas_padding;
+    *y = rect.y + atlas_padding;
+    return true;
+}
+
+void ThumbAtlas::add(usize slot, Image thumb) {
+    if (!thumb.data || thumb.format != IMAGE_RGBA8 || has(slot)) return;
+    if (thumb.width + atlas_padding * 2 > size || thumb.height + atlas_padding * 2 > size) {
+        err("thumbnail is bigger than the atlas: %dx%d", thumb.width, thumb.height);
+        return;
+    }
+
+    // only the last atlas has room, the older ones are kept full
+    int x = 0, y = 0;
+    atlas *a = atlases.len > 0 ? &atlases.back() : nullptr;
+    if (!a || !pack(*a, thumb.width, thumb.height, &x, &y)) {
+        a = &new_atlas();
+        pack(*a, thumb.width, thumb.height, &x, &y);
+    }
+
+    usize row = (usize)thumb.width * 4;
+    for (int i = 0; i < thumb.height; ++i) {
+        memcpy(a->pixels + ((usize)(y + i) * size + x) * 4, thumb.data + row * i, row);
+    }
+    a->dirty = true;
+
+    if (slot >= thumbs.len) {
+        thumbs.resize(slot + 1);
+    }
+    float s = (float)size;
+    thumbs[slot] = {
+        a->tex,
+        { x / s, y / s },
+        { (x + thumb.width) / s, (y + thumb.height) / s },
+        { (float)thumb.width, (float)thumb.height },
+    };
+}
+
+void ThumbAtlas::flush() {
+    if (last_flush && stm_ms(stm_since(last_flush)) < atlas_flush_interval_ms) return;
+
+    bool flushed = false;
+    for (auto &a : atlases) {
+        if (!a.dirty) continue;
+        updateDynamicTexture(a.tex, a.pixels, (usize)size * size * 4);
+        a.dirty = false;
+        flushed = true;
+    }
+    if (flushed) {
+        last_flush = stm_now();
+    }
+}
+
+const Thumb &ThumbAtlas::get(usize slot) const {
+    static const Thumb none = {};
+    return has(slot) ? thumbs[slot] : none;
+}
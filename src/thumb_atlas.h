@@ -0,0 +1,62 @@
+#pragma once
+
+#include <imgui.h>
+
+#include "utils/vec.h"
+
+#include "framework/framework.h"
+
+struct stbrp_context;
+struct stbrp_node;
+
+constexpr int atlas_size = 2048;
+// empty pixels around every thumbnail so linear filtering doesn't bleed
+// the neighbours in
+constexpr int atlas_padding = 1;
+// an atlas is a whole texture upload (16 MB at 2048), while thumbnails
+// stream in they're batched for this long
+constexpr double atlas_flush_interval_ms = 250.0;
+
+struct Thumb {
+    // id 0 while the page doesn't have one
+    Texture tex;
+    ImVec2 uv0, uv1;
+    ImVec2 size;
+};
+
+// thumbnails of every page packed in a few big RGBA8 textures, so the
+// whole overview draws with a handful of draw calls instead of one per
+// page. a new atlas is made when the current ones are full, thumbnails are
+// never removed since they are tiny compared to the pages.
+// the pixels stay on the cpu too, the changed atlases are replaced by
+// flush() at most once every atlas_flush_interval_ms
+struct ThumbAtlas {
+    void init(int side = atlas_size);
+    void shutdown();
+
+    // copies the RGBA8 thumbnail in, main thread only
+    void add(usize slot, Image thumb);
+    void flush();
+
+    const Thumb &get(usize slot) const;
+    bool has(usize slot) const { return slot < thumbs.len && thumbs[slot].tex.id != 0; }
+    int atlas_count() const { return (int)atlases.len; }
+
+private:
+    struct atlas {
+        Texture tex;
+        uchar *pixels;
+        stbrp_context *packer;
+        stbrp_node *nodes;
+        bool dirty;
+    };
+
+    bool pack(atlas &a, int width, int height, int *x, int *y);
+    atlas &new_atlas();
+
+    int size = atlas_size;
+    vec<atlas> atlases;
+    u64 last_flush = 0;
+    // indexed by image slot
+    vec<Thumb> thumbs;
+};
@@ -1,8 +1,20 @@
 #include "http.h"
 
+#include <time.h>
+#include <limits.h>
+#include <chrono>
+
+#if SOCK_POSIX
+    #include <poll.h>
+    #include <fcntl.h>
+    #include <errno.h>
+#endif
+
 // TODO change this
 #include <strstream.h>
 
+#include "../chrome_trace.h"
+
 namespace http {
     
     const char *req_error_str(req_error error) {
@@ -15,6 +27,8 @@ namespace http {
         case REQERR_CONNECT: return "Couldn't connect to host";
         case REQERR_CLOSE: return "Couldn't close socket";
         case REQERR_CLEANUP: return "couldn't clean up sockets";
+        case REQERR_TIMEOUT: return "The server took too long to answer";
+        case REQERR_CANCELLED: return "The request was cancelled";
         }
         return "unrecognised error";
     }
@@ -53,7 +67,9 @@ namespace http {
         );
 
         for (const auto &field : fields) {
-            ostrPrintf(&out, "%s: %s\r\n", field.key.buf, field.value.buf);
+            ostrPrintf(&out, "%.*s: %.*s\r\n",
+                (int)field.key.len, field.key.buf, (int)field.value.len, field.value.buf
+            );
         }
 
         ostrAppendview(&out, strvInit("\r\n"));
@@ -65,13 +81,49 @@ namespace http {
     }
 
 
-    void res::parse(const vec<u8> &in_data) {
-        auto in = istrInitLen((const char *)in_data.buf, in_data.len);
+    static void append_bytes(vec<u8> &out, const u8 *data, usize len) {
+        if (out.len + len > out.cap) {
+            usize newcap = out.cap ? out.cap * 2 : req_buf_len;
+            while (newcap < out.len + len) newcap *= 2;
+            out.grow(newcap);
+        }
+        memcpy(out.buf + out.len, data, len);
+        out.len += len;
+    }
+
+    static bool parse_chunk_size(slice<const u8> line, usize &size) {
+        size = 0;
+        usize i = 0;
+        for (; i < line.len; ++i) {
+            u8 c = line[i];
+            usize digit = 0;
+            if      (c >= '0' && c <= '9') digit = (usize)(c - '0');
+            else if (c >= 'a' && c <= 'f') digit = (usize)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') digit = (usize)(c - 'A' + 10);
+            // chunk extensions (;name=value) are ignored
+            else break;
+            if (size > (max_body_len - digit) / 16) return false;
+            size = size * 16 + digit;
+        }
+        return i > 0;
+    }
+
+    usize res::parse_head(slice<const u8> in_data) {
+        usize head_len = 0;
+        for (usize i = 0; i + 3 < in_data.len; ++i) {
+            if (memcmp(in_data.buf + i, "\r\n\r\n", 4) == 0) {
+                head_len = i + 4;
+                break;
+            }
+        }
+        if (head_len == 0) return 0;
+
+        auto in = istrInitLen((const char *)in_data.buf, head_len);
 
         char hp[5];
         istrGetstringBuf(&in, hp, 5);
         if (stricmp(hp, "http") != 0) {
-            return;
+            return head_len;
         }
         istrSkip(&in, 1); // skip /
         istrGetu8(&in, &ver.major);
@@ -90,21 +142,386 @@ namespace http {
             size_t pos = strvFind(line, ':', 0);
             if(pos != STRV_NOT_FOUND) {
                 strview_t key = strvSubstr(line, 0, pos);
-                strview_t value = strvSubstr(line, pos + 2, SIZE_MAX);
+                strview_t value = strvSubstr(line, pos + 1, SIZE_MAX);
+                while (value.len > 0 && value.buf[0] == ' ') {
+                    ++value.buf;
+                    --value.len;
+                }
 
                 fields.set({ key.buf, key.len }, { value.buf, value.len });
             }
 
             istrSkip(&in, 2); // skip \r\n
-        } while(line.len > 2);
+        } while(line.len > 0);
+
+        return head_len;
+    }
+
+    void res_parser::reset(res *out, vec<u8> *body_buf, bool no_body) {
+        response = out;
+        body = body_buf;
+        skip_body = no_body;
+        state = PARSE_HEAD;
+        remaining = 0;
+        head.clear();
+        line.clear();
+        body->clear();
+    }
+
+    usize res_parser::feed(slice<const u8> data) {
+        usize used = 0;
+
+        while (used < data.len && state != PARSE_DONE && state != PARSE_ERROR) {
+            const u8 *cur = data.buf + used;
+            usize avail = data.len - used;
+
+            switch (state) {
+            case PARSE_HEAD:
+            {
+                // the terminator could be split between two reads
+                usize from = head.len > 3 ? head.len - 3 : 0;
+                append_bytes(head, cur, avail);
+                usize head_len = 0;
+                for (usize i = from; i + 3 < head.len; ++i) {
+                    if (memcmp(head.buf + i, "\r\n\r\n", 4) == 0) {
+                        head_len = i + 4;
+                        break;
+                    }
+                }
+                if (head_len == 0) {
+                    used += avail;
+                    break;
+                }
+                // give back whatever came after the head
+                used += avail - (head.len - head_len);
+                head.len = head_len;
+                start_body();
+                break;
+            }
+            case PARSE_BODY:
+            case PARSE_CHUNK_DATA:
+            {
+                usize len = avail < remaining ? avail : remaining;
+                append_bytes(*body, cur, len);
+                remaining -= len;
+                used += len;
+                if (remaining == 0) {
+                    state = state == PARSE_BODY ? PARSE_DONE : PARSE_CHUNK_END;
+                }
+                break;
+            }
+            case PARSE_UNTIL_EOF:
+                append_bytes(*body, cur, avail);
+                used += avail;
+                break;
+            case PARSE_CHUNK_SIZE:
+            case PARSE_CHUNK_END:
+            case PARSE_TRAILERS:
+            {
+                // these are all line based, collect a whole line before parsing it
+                usize end = 0;
+                while (end < avail && cur[end] != '\n') ++end;
+                if (end == avail) {
+                    append_bytes(line, cur, avail);
+                    used += avail;
+                    break;
+                }
+                append_bytes(line, cur, end);
+                used += end + 1;
+                if (line.len > 0 && line.back() == '\r') --line.len;
+                end_line();
+                line.clear();
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        return used;
+    }
+
+    slice<u8> res_parser::body_dst() {
+        // small chunks are cheaper to get through the stack buffer
+        // than with one recv each
+        bool direct = state == PARSE_BODY ||
+                      (state == PARSE_CHUNK_DATA && remaining >= req_buf_len);
+        if (!direct) return {};
+
+        if (body->len + remaining > body->cap) {
+            // the whole body is known, reserve exactly that
+            if (state == PARSE_BODY) {
+                body->grow(body->len + remaining);
+            }
+            else {
+                usize newcap = body->cap ? body->cap * 2 : req_buf_len;
+                while (newcap < body->len + remaining) newcap *= 2;
+                body->grow(newcap);
+            }
+        }
+
+        return { body->buf + body->len, remaining };
+    }
+
+    void res_parser::body_written(usize len) {
+        assert(len <= remaining);
+        body->len += len;
+        remaining -= len;
+        if (remaining == 0) {
+            state = state == PARSE_BODY ? PARSE_DONE : PARSE_CHUNK_END;
+        }
+    }
+
+    void res_parser::finish() {
+        // without any framing the server closing the connection
+        // is the only way to know that the body is finished
+        if (state == PARSE_UNTIL_EOF) {
+            state = PARSE_DONE;
+        }
+        else if (state != PARSE_DONE) {
+            state = PARSE_ERROR;
+        }
+    }
+
+    bool res_parser::keep_alive() {
+        return state == PARSE_DONE && !until_eof && response->keep_alive();
+    }
+
+    static bool body_fits(usize len, usize more) {
+        return len <= max_body_len && more <= max_body_len - len;
+    }
+
+    static bool parse_length(str_view text, usize &value) {
+        value = 0;
+        for (char c : text) {
+            if (c < '0' || c > '9') return false;
+            usize digit = (usize)(c - '0');
+            if (value > (max_body_len - digit) / 10) return false;
+            value = value * 10 + digit;
+        }
+        return !text.empty();
+    }
+
+    void res_parser::start_body() {
+        // the response keeps the head, its fields point into it
+        response->head = move(head);
+        if (response->parse_head({ response->head.buf, response->head.len }) == 0) {
+            state = PARSE_ERROR;
+            return;
+        }
 
-        const char *tran_encoding = fields.get("transfer-encoding");
-        if(tran_encoding == NULL || stricmp(tran_encoding, "chunked") != 0) {
-            auto data_slice = slice<u8>((u8*)in.cur, in.size - (in.cur - in.start));
-            data.append_slice(data_slice);
+        until_eof = false;
+
+        str_view tran_encoding = response->fields.get("transfer-encoding");
+        str_view content_len = response->fields.get("content-length");
+
+        int status = (int)response->status;
+        if (skip_body || (status >= 100 && status < 200) || status == STATUS_NO_CONTENT || status == STATUS_NOT_MODIFIED) {
+            state = PARSE_DONE;
+        }
+        else if (equals_nocase(tran_encoding, "chunked")) {
+            state = PARSE_CHUNK_SIZE;
+        }
+        else if (content_len.buf) {
+            if (!parse_length(content_len, remaining) || !body_fits(body->len, remaining)) {
+                state = PARSE_ERROR;
+                return;
+            }
+            state = remaining ? PARSE_BODY : PARSE_DONE;
+            // the body is received in place, so there's no need to grow it later
+            body->grow(body->len + remaining);
+        }
+        else {
+            until_eof = true;
+            state = PARSE_UNTIL_EOF;
+        }
+    }
+
+    void res_parser::end_line() {
+        switch (state) {
+        case PARSE_CHUNK_SIZE:
+            if (!parse_chunk_size({ line.buf, line.len }, remaining) || !body_fits(body->len, remaining)) {
+                state = PARSE_ERROR;
+            }
+            else {
+                state = remaining ? PARSE_CHUNK_DATA : PARSE_TRAILERS;
+            }
+            break;
+        case PARSE_CHUNK_END:
+            state = line.len == 0 ? PARSE_CHUNK_SIZE : PARSE_ERROR;
+            break;
+        case PARSE_TRAILERS:
+            // trailers are ignored, they end with an empty line
+            if (line.len == 0) state = PARSE_DONE;
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool res::keep_alive() {
+        str_view connection = fields.get("connection");
+        if (equals_nocase(connection, "close")) {
+            return false;
+        }
+        if (ver.to_int() < 11) {
+            return equals_nocase(connection, "keep-alive");
+        }
+        return true;
+    }
+
+
+    url parse_url(str_view full_url) {
+        url out;
+        usize start = 0;
+
+        for (usize i = 0; i + 2 < full_url.len; ++i) {
+            if (full_url[i] == ':' && full_url[i + 1] == '/' && full_url[i + 2] == '/') {
+                start = i + 3;
+                break;
+            }
+        }
+
+        usize end = start;
+        usize colon = 0;
+        while (end < full_url.len && full_url[end] != '/') {
+            if (full_url[end] == ':') colon = end;
+            ++end;
+        }
+
+        if (colon) {
+            out.host = full_url.sub(start, colon);
+            u32 port = 0;
+            for (usize i = colon + 1; i < end && isdigit(full_url[i]); ++i) {
+                port = port * 10 + (full_url[i] - '0');
+            }
+            out.port = (u16)port;
+        }
+        else {
+            out.host = full_url.sub(start, end);
         }
+        out.uri = full_url.sub(end);
+        return out;
+    }
+
+
+    static i64 now_ms() {
+        using namespace std::chrono;
+        return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
     }
 
+#if SOCK_WINDOWS
+    static bool set_nonblocking(socket_t sock) {
+        u_long mode = 1;
+        return ioctlsocket(sock, FIONBIO, &mode) == 0;
+    }
+
+    static bool would_block() {
+        int error = WSAGetLastError();
+        return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+    }
+
+    static int poll_socket(socket_t sock, bool write, int timeout) {
+        WSAPOLLFD fd = { sock, (SHORT)(write ? POLLWRNORM : POLLRDNORM), 0 };
+        return WSAPoll(&fd, 1, timeout);
+    }
+
+    static bool interrupted() {
+        return false;
+    }
+
+    static int pending_error(socket_t sock) {
+        int error = 0;
+        int len = sizeof(error);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&error, &len);
+        return error;
+    }
+#else
+    static bool set_nonblocking(socket_t sock) {
+        int flags = fcntl(sock, F_GETFL, 0);
+        return flags != -1 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) != -1;
+    }
+
+    static bool would_block() {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS;
+    }
+
+    static int poll_socket(socket_t sock, bool write, int timeout) {
+        pollfd fd = { sock, (short)(write ? POLLOUT : POLLIN), 0 };
+        return poll(&fd, 1, timeout);
+    }
+
+    static bool interrupted() {
+        return errno == EINTR;
+    }
+
+    static int pending_error(socket_t sock) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len);
+        return error;
+    }
+#endif
+
+    // waits until the socket can be read (or written), in small steps so
+    // that a cancelled request gives up within cancel_poll_ms
+    static bool wait_socket(socket_t sock, bool write, const cancel_token &cancel, int timeout_ms, req_error &error) {
+        i64 deadline = now_ms() + timeout_ms;
+        while (true) {
+            if (cancel.cancelled()) {
+                error = REQERR_CANCELLED;
+                return false;
+            }
+            i64 left = deadline - now_ms();
+            if (left <= 0) {
+                error = REQERR_TIMEOUT;
+                return false;
+            }
+            int ready = poll_socket(sock, write, left < cancel_poll_ms ? (int)left : cancel_poll_ms);
+            // errors and hang ups count as ready, the next call reports them
+            if (ready > 0) return true;
+            if (ready < 0 && !interrupted()) {
+                error = REQERR_DATA;
+                return false;
+            }
+        }
+    }
+
+    static bool send_all(socket_t sock, const char *data, usize len, const cancel_token &cancel, int timeout_ms, req_error &error) {
+        while (len > 0) {
+            int chunk = len > INT_MAX ? INT_MAX : (int)len;
+            int sent = skSend(sock, data, chunk);
+            if (sent == SOCKET_ERROR) {
+                if (!would_block()) {
+                    error = REQERR_SOCK;
+                    return false;
+                }
+                if (!wait_socket(sock, true, cancel, timeout_ms, error)) {
+                    return false;
+                }
+                continue;
+            }
+            data += sent;
+            len -= (usize)sent;
+        }
+        return true;
+    }
+
+    // like skReceive, but waits for the data without blocking the thread
+    // for longer than cancel_poll_ms. returns -1 and sets error on failure
+    static int receive(socket_t sock, void *buf, int len, const cancel_token &cancel, int timeout_ms, req_error &error) {
+        while (true) {
+            int read = skReceive(sock, buf, len);
+            if (read >= 0) return read;
+            if (!would_block()) {
+                error = REQERR_DATA;
+                return -1;
+            }
+            if (!wait_socket(sock, false, cancel, timeout_ms, error)) {
+                return -1;
+            }
+        }
+    }
 
     void client::set_host(str_view hostname) {
         if (hostname.empty()) return;
@@ -121,10 +538,8 @@ namespace http {
         }
     }
 
-    optional<res, req_error> client::send_req(req &request) {
-        optional<res, req_error> out;
-        out.success = true;
-
+    optional<res, req_error> client::send_req(req &request, vec<u8> &body) {
+        SPAN("http request");
         assert(!host_name.empty());
         
         if (host_name[host_name.len - 1] == '/') {
@@ -140,9 +555,8 @@ namespace http {
                 fields.set("Content-Length", "0");
             }
             else {
-                char buf[20];
-                snprintf(buf, sizeof(buf), "%llu", request.body.len);
-                fields.set("Content-Length", buf);
+                snprintf(request.content_len, sizeof(request.content_len), "%llu", (unsigned long long)request.body.len);
+                fields.set("Content-Length", request.content_len);
             }
         }
 
@@ -151,76 +565,330 @@ namespace http {
         }
 
         if (request.ver.to_int() >= 11) {
-            fields.has_set("Connection", "close");
+            fields.has_set("Connection", "keep-alive");
+        }
+
+        str req_str = request.to_string();
+        if (req_str.empty()) {
+            return REQERR_STR;
         }
 
         res response;
-        vec<u8> received;
+        req_error error = REQERR_DATA;
+        bool success = false;
+
+        // the server might have closed a pooled connection while it was idle,
+        // in that case we get nothing back and we retry once on a new one
+        for (int attempt = 0; attempt < 2 && !success; ++attempt) {
+            bool reused = false;
+            socket = pool().acquire(host_name, port, reused, error, cancel, timeout_ms);
+            if (socket == INVALID_SOCKET) {
+                break;
+            }
 
-        if (!skInit()) {
-            out = REQERR_INIT;
-            goto skopen_error;
+            response = {};
+            bool keep_alive = false;
+            usize received = 0;
+            success = exchange(req_str, response, body, request.method == REQ_HEAD, keep_alive, received, error);
+
+            if (success && keep_alive) {
+                pool().release(host_name, port, socket);
+            }
+            else {
+                pool().discard(socket);
+            }
+            socket = INVALID_SOCKET;
+
+            bool gave_up = error == REQERR_CANCELLED || error == REQERR_TIMEOUT;
+            if (!success && (gave_up || !(reused && received == 0))) {
+                break;
+            }
         }
 
-        socket = skOpen(SOCK_TCP);
-        if (socket == INVALID_SOCKET) {
-            out = REQERR_OPEN;
-            goto error;
+        if (!success) {
+            return error;
         }
 
-        if (skConnect(socket, host_name.buf, port)) {
-            str req_str = request.to_string();
-            if (req_str.empty()) {
-                out = REQERR_STR;
-                goto error;
+        response.body = { body.buf, body.len };
+        return response;
+    }
+
+    bool client::exchange(const str &req_str, res &response, vec<u8> &body, bool no_body, bool &keep_alive, usize &received, req_error &error) {
+        {
+            SPAN("http send");
+            if (!send_all(socket, req_str.buf, req_str.len, cancel, timeout_ms, error)) {
+                return false;
             }
+        }
 
-            if (skSend(socket, req_str.buf, (int)req_str.len) == SOCKET_ERROR) {
-                out = REQERR_SOCK;
-                goto error;
+        // from the request going out to the last byte of the response
+        SPAN("http receive");
+
+        res_parser parser;
+        parser.reset(&response, &body, no_body);
+
+        u8 buffer[req_buf_len];
+        // how much of the body was already given to the sink
+        usize streamed = 0;
+
+        while (!parser.done()) {
+            if (sink.on_data && body.len > streamed) {
+                sink.on_data({ body.buf + streamed, body.len - streamed }, sink.udata);
+                streamed = body.len;
             }
 
-            u8 buffer[req_buf_len];
-            int read = 0;
-            do {
-                read = skReceive(socket, buffer, sizeof(buffer));
-                if (read == -1) {
-                    out = REQERR_DATA;
-                    goto error;
+            // once the body size is known, skip the stack buffer and
+            // receive directly in the final buffer
+            slice<u8> dst = parser.body_dst();
+            if (!dst.empty()) {
+                int max_read = dst.len > INT_MAX ? INT_MAX : (int)dst.len;
+                int read = receive(socket, dst.buf, max_read, cancel, timeout_ms, error);
+                if (read <= 0) {
+                    if (read == 0) error = REQERR_DATA;
+                    return false;
                 }
-                received.append_slice({ buffer, (usize)read });
-            } while (read != 0);
+                received += (usize)read;
+                parser.body_written((usize)read);
+                continue;
+            }
+
+            int read = receive(socket, buffer, sizeof(buffer), cancel, timeout_ms, error);
+            if (read < 0) {
+                return false;
+            }
+            if (read == 0) {
+                parser.finish();
+                break;
+            }
 
-            response.parse(received);
+            received += (usize)read;
+            usize used = parser.feed({ buffer, (usize)read });
+            if (parser.failed()) {
+                error = REQERR_DATA;
+                return false;
+            }
+            // the server sent more than one response, the connection
+            // is out of sync so it can't be reused
+            if (used < (usize)read) {
+                parser.until_eof = true;
+            }
         }
-        else {
-            out = REQERR_CONNECT;
+
+        if (!parser.done()) {
+            error = REQERR_DATA;
+            return false;
         }
 
-        if (!skClose(socket)) {
-            out = REQERR_CLOSE;
+        if (sink.on_data && body.len > streamed) {
+            sink.on_data({ body.buf + streamed, body.len - streamed }, sink.udata);
         }
 
-        if (out.good()) {
-            out = response;
+        keep_alive = parser.keep_alive();
+        return true;
+    }
+
+
+    static i64 now_sec() {
+        return (i64)time(nullptr);
+    }
+
+    bool conn_pool::init() {
+        if (!initialized) {
+            initialized = skInit();
         }
+        return initialized;
+    }
 
-error:
-        if (!skCleanup()) {
-            out = REQERR_CLEANUP;
+    bool conn_pool::find_host_locked(const str &host, u16 host_port, usize &index) {
+        for (usize i = 0; i < hosts.len; ++i) {
+            if (hosts[i].port == host_port && hosts[i].name == host.to_slice()) {
+                index = i;
+                return true;
+            }
         }
-skopen_error:
-        return out;
+        return false;
+    }
+
+    bool conn_pool::add_host(const str &host, u16 host_port, usize &index) {
+        std::lock_guard<std::mutex> dns_lock(dns_mtx);
+
+        // another worker may have resolved it while this one was waiting
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (find_host_locked(host, host_port, index)) return true;
+        }
+
+        // only resolve each host once, the address is reused by all the connections
+        host_entry entry;
+        entry.name = host;
+        entry.port = host_port;
+        {
+            SPAN("http dns");
+            if (!skResolve(host.buf, host_port, &entry.addr)) {
+                return false;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        hosts.append(entry);
+        index = hosts.len - 1;
+        return true;
+    }
+
+    socket_t conn_pool::acquire(const str &host, u16 host_port, bool &reused, req_error &error, const cancel_token &cancel, int timeout_ms) {
+        reused = false;
+        sk_addrin_t addr;
+        usize index = 0;
+        bool known = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            if (!init()) {
+                error = REQERR_INIT;
+                return INVALID_SOCKET;
+            }
+
+            evict_idle_locked(now_sec());
+            known = find_host_locked(host, host_port, index);
+        }
+
+        // a new host has to be resolved first, which can take a while, the
+        // other workers keep using the pool meanwhile
+        if (!known) {
+            if (cancel.cancelled()) {
+                error = REQERR_CANCELLED;
+                return INVALID_SOCKET;
+            }
+            if (!add_host(host, host_port, index)) {
+                error = REQERR_CONNECT;
+                return INVALID_SOCKET;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            // the most recently used connections are at the back
+            for (usize i = idle.len; i-- > 0;) {
+                if (idle[i].host == index) {
+                    socket_t sock = idle[i].sock;
+                    idle.remove(i, false);
+                    reused = true;
+                    return sock;
+                }
+            }
+
+            addr = hosts[index].addr;
+        }
+
+        SPAN("http connect");
+        socket_t sock = skOpen(SOCK_TCP);
+        if (sock == INVALID_SOCKET) {
+            error = REQERR_OPEN;
+            return INVALID_SOCKET;
+        }
+
+        if (!set_nonblocking(sock)) {
+            skClose(sock);
+            error = REQERR_OPEN;
+            return INVALID_SOCKET;
+        }
+
+        // the connection is done once the socket becomes writable
+        if (!skConnectPro(sock, (sk_addr_t *)&addr, sizeof(addr))) {
+            if (!would_block()) {
+                skClose(sock);
+                error = REQERR_CONNECT;
+                return INVALID_SOCKET;
+            }
+            if (!wait_socket(sock, true, cancel, timeout_ms, error)) {
+                skClose(sock);
+                return INVALID_SOCKET;
+            }
+            if (pending_error(sock) != 0) {
+                skClose(sock);
+                error = REQERR_CONNECT;
+                return INVALID_SOCKET;
+            }
+        }
+
+        return sock;
+    }
+
+    void conn_pool::release(const str &host, u16 host_port, socket_t sock) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        // acquire already resolved it
+        usize index = 0;
+        if (!find_host_locked(host, host_port, index)) {
+            skClose(sock);
+            return;
+        }
+
+        if (idle.len >= max_idle_conn) {
+            skClose(idle[0].sock);
+            idle.remove(0, false);
+        }
+
+        idle.append({ sock, index, now_sec() });
+    }
+
+    void conn_pool::discard(socket_t sock) {
+        skClose(sock);
+    }
+
+    void conn_pool::evict_idle() {
+        std::lock_guard<std::mutex> lock(mtx);
+        evict_idle_locked(now_sec());
+    }
+
+    void conn_pool::evict_idle_locked(i64 now) {
+        // idle is sorted by last_used, so the old ones are all at the front
+        usize count = 0;
+        while (count < idle.len && (now - idle[count].last_used) > conn_idle_timeout) {
+            skClose(idle[count].sock);
+            ++count;
+        }
+        for (usize i = 0; i < count; ++i) {
+            idle.remove(0, false);
+        }
+    }
+
+    void conn_pool::shutdown() {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        for (const auto &conn : idle) {
+            skClose(conn.sock);
+        }
+        idle.clear();
+
+        if (initialized) {
+            skCleanup();
+            initialized = false;
+        }
+    }
+
+    conn_pool &pool() {
+        static conn_pool global_pool;
+        return global_pool;
+    }
+
+    void shutdown() {
+        pool().shutdown();
     }
 
 
-    optional<res, req_error> get(str_view host, str_view uri) {
+    optional<res, req_error> get(str_view host, str_view uri, vec<u8> &body, u16 port, const cancel_token &cancel, const body_sink &sink) {
         req request;
         request.set_uri(uri);
 
         client c;
         c.set_host(host);
-        return c.send_req(request);
+        c.port = port;
+        c.cancel = cancel;
+        c.sink = sink;
+        return c.send_req(request, body);
     }
 
 } // namespace http
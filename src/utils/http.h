@@ -6,11 +6,25 @@
 #include "map.h"
 #include "optional.h"
 
+#include <mutex>
+#include <atomic>
+
 // TODO change this
 #include <socket.h>
 
 namespace http {
     constexpr int req_buf_len = 1024 * 10;
+    // idle keep-alive connections older than this (in seconds) get closed
+    constexpr int conn_idle_timeout = 15;
+    constexpr int max_idle_conn = 32;
+    // sockets are non-blocking, a request fails if connecting or waiting for
+    // the next bytes takes longer than this
+    constexpr int io_timeout_ms = 10000;
+    // how often a waiting request checks if it was cancelled
+    constexpr int cancel_poll_ms = 10;
+    // bodies announced bigger than this fail with REQERR_DATA instead of
+    // being allocated, pages are a few MB
+    constexpr usize max_body_len = 256ull * 1024 * 1024;
 
     enum req_type {
         REQ_GET,
@@ -60,10 +74,29 @@ namespace http {
         REQERR_CONNECT,
         REQERR_CLOSE,
         REQERR_CLEANUP,
+        REQERR_TIMEOUT,
+        REQERR_CANCELLED,
     };
 
     const char *req_error_str(req_error error);
 
+    // a request is cancelled as soon as *counter stops being value, so
+    // bumping one counter cancels every request started before it.
+    // the default token is never cancelled
+    struct cancel_token {
+        bool cancelled() const { return counter && counter->load(std::memory_order_relaxed) != value; }
+
+        const std::atomic<int> *counter = nullptr;
+        int value = 0;
+    };
+
+    // gets every piece of the (de-chunked) body as soon as it's received,
+    // the pieces are also kept in the body buffer as usual
+    struct body_sink {
+        void (*on_data)(slice<const u8> data, void *udata) = nullptr;
+        void *udata = nullptr;
+    };
+
     struct version {
         int to_int();
         u8 major, minor;
@@ -81,28 +114,157 @@ namespace http {
 
         req_type method = REQ_GET;
         version ver = { 1, 1 };
-        map fields;
+        // the fields aren't copied, their keys and values have to live as
+        // long as the request. Host points into the client's host_name
+        header_map fields;
         str uri = "/";
         str body;
+        // backs the Content-Length field set by send_req
+        char content_len[24] = {};
     };
 
     struct res {
-        void parse(const vec<u8> &data);
+        res() = default;
+        // the fields point into head, a copy would point into the original
+        res(const res &) = delete;
+        res(res &&) = default;
+        res &operator=(const res &) = delete;
+        res &operator=(res &&) = default;
+
+        // parses the status line and the header fields, returns the size of
+        // the head or 0 if data doesn't contain all of it yet. the fields
+        // point into data
+        usize parse_head(slice<const u8> data);
+        // true if the server is going to keep the connection open
+        bool keep_alive();
 
         status_type status = STATUS_OK;
-        map fields;
+        // views into head
+        header_map fields;
+        vec<u8> head;
         version ver = { 1, 1 };
-        vec<u8> data;
+        // points into the buffer passed to send_req, only valid until it gets reused
+        slice<u8> body;
+    };
+
+    enum parse_state {
+        PARSE_HEAD,
+        PARSE_BODY,
+        PARSE_UNTIL_EOF,
+        PARSE_CHUNK_SIZE,
+        PARSE_CHUNK_DATA,
+        PARSE_CHUNK_END,
+        PARSE_TRAILERS,
+        PARSE_DONE,
+        PARSE_ERROR,
+    };
+
+    // incremental response parser, it can be fed the bytes as they come out
+    // of the socket. the (de-chunked) body is written straight into body
+    struct res_parser {
+        void reset(res *out, vec<u8> *body_buf, bool no_body = false);
+        // returns how many bytes of data were used, anything after the end
+        // of the response is left alone
+        usize feed(slice<const u8> data);
+        // when the parser is in the middle of a body, returns the space in
+        // body where the next bytes go, so they can be received in place.
+        // the returned slice is empty otherwise
+        slice<u8> body_dst();
+        // marks len bytes written in the slice returned by body_dst as received
+        void body_written(usize len);
+        // to be called when the server closes the connection
+        void finish();
+        bool keep_alive();
+
+        bool done() const { return state == PARSE_DONE; }
+        bool failed() const { return state == PARSE_ERROR; }
+
+        parse_state state = PARSE_HEAD;
+        res *response = nullptr;
+        vec<u8> *body = nullptr;
+        vec<u8> head;
+        vec<u8> line;
+        usize remaining = 0;
+        bool skip_body = false;
+        bool until_eof = false;
+
+    private:
+        void start_body();
+        void end_line();
+    };
+
+    struct url {
+        str_view host;
+        str_view uri;
+        u16 port = 80;
     };
 
+    // splits "scheme://host:port/uri" into its parts, scheme and port are optional
+    url parse_url(str_view full_url);
+
     struct client {
         void set_host(str_view hostname);
-        optional<res, req_error> send_req(req &request);
+        // the body of the response is written into body, pass the same
+        // buffer to multiple requests to avoid reallocating it every time
+        optional<res, req_error> send_req(req &request, vec<u8> &body);
 
         str host_name;
         u16 port = 80;
-        socket_t socket;
+        socket_t socket = INVALID_SOCKET;
+        // checked every cancel_poll_ms while waiting on the socket
+        cancel_token cancel;
+        int timeout_ms = io_timeout_ms;
+        body_sink sink;
+
+    private:
+        bool exchange(const str &req_str, res &response, vec<u8> &body, bool no_body, bool &keep_alive, usize &received, req_error &error);
     };
 
-    optional<res, req_error> get(str_view host, str_view uri);
+    // keeps the sockets of finished requests open so that the next request
+    // to the same host can skip the dns lookup and the tcp handshake
+    struct conn_pool {
+        // returns an idle connection to host or opens a new one,
+        // reused is set to true if the connection was already open
+        socket_t acquire(const str &host, u16 port, bool &reused, req_error &error, const cancel_token &cancel = {}, int timeout_ms = io_timeout_ms);
+        // gives back a connection that can be used for another request
+        void release(const str &host, u16 port, socket_t sock);
+        // closes a connection that can't be reused
+        void discard(socket_t sock);
+        // closes all the connections idle for more than conn_idle_timeout
+        void evict_idle();
+        void shutdown();
+
+    private:
+        struct host_entry {
+            str name;
+            u16 port;
+            sk_addrin_t addr;
+        };
+
+        struct idle_conn {
+            socket_t sock;
+            usize host;
+            i64 last_used;
+        };
+
+        bool init();
+        bool find_host_locked(const str &host, u16 port, usize &index);
+        // resolves host without holding mtx, returns its index in hosts
+        bool add_host(const str &host, u16 port, usize &index);
+        void evict_idle_locked(i64 now);
+
+        std::mutex mtx;
+        // gethostbyname isn't reentrant, lookups take turns on this one
+        // instead of blocking the whole pool
+        std::mutex dns_mtx;
+        bool initialized = false;
+        vec<host_entry> hosts;
+        vec<idle_conn> idle;
+    };
+
+    conn_pool &pool();
+    // closes all the pooled connections, call it before exiting
+    void shutdown();
+
+    optional<res, req_error> get(str_view host, str_view uri, vec<u8> &body, u16 port = 80, const cancel_token &cancel = {}, const body_sink &sink = {});
 } // namespace http
\ No newline at end of file
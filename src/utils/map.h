@@ -1,57 +1,161 @@
 #pragma once
 
+#include <string.h>
+
 #include "vec.h"
-#include "str.h"
 #include "slice.h"
+#include "defines.h"
 
-struct map {
-    const char *get(str_view key) {
-        for (auto &d : data) {
-            if (d.key.equals(key), false) {
-                return d.value.buf;
-            }
-        }
-        return nullptr;
+// the fields of a response usually fit, only bigger maps allocate
+constexpr usize header_map_inline = 16;
+
+inline char ascii_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? (char)(c | 0x20) : c;
+}
+
+inline bool equals_nocase(str_view a, str_view b) {
+    if (a.len != b.len) return false;
+    for (usize i = 0; i < a.len; ++i) {
+        if (ascii_lower(a.buf[i]) != ascii_lower(b.buf[i])) return false;
     }
+    return true;
+}
 
-    void set(str_view key, str_view value) {
-        for (auto &d : data) {
-            if (d.key.equals(key), false) {
-                d.value = value;
-                return;
-            }
+// case insensitive map of http header fields. it doesn't copy anything,
+// keys and values are views into memory that has to outlive the map, like
+// the head of a response or string literals
+struct header_map {
+    struct field {
+        str_view key;
+        str_view value;
+        u32 hash;
+    };
+
+    // returns an empty view with a null buf if key isn't there
+    str_view get(str_view key) const {
+        const field *f = find(key);
+        return f ? f->value : str_view{};
+    }
+
+    const field *find(str_view key) const {
+        u32 hash = hash_key(key);
+        const field *all = fields();
+        usize mask = index_len() - 1;
+        for (usize i = hash & mask;; i = (i + 1) & mask) {
+            u16 slot = index()[i];
+            if (slot == 0) return nullptr;
+            const field &f = all[slot - 1];
+            if (f.hash == hash && equals_nocase(f.key, key)) return &f;
         }
-        data.append({key, value});
+    }
+
+    field *find(str_view key) {
+        return const_cast<field *>(static_cast<const header_map *>(this)->find(key));
     }
 
     bool has(str_view key) const {
-        for (const auto &d : data) {
-            if (d.key.equals(key), false) {
-                return true;
-            }
+        return find(key) != nullptr;
+    }
+
+    void set(str_view key, str_view value) {
+        if (field *f = find(key)) {
+            f->value = value;
+            return;
         }
-        return false;
+        add(key, value);
     }
 
+    // only sets the value if the field isn't there or is empty
     void has_set(str_view key, str_view value) {
-        for(auto &d : data) {
-            if (d.key.equals(key), false) {
-                if (d.value.empty()) {
-                    d.value = value;
-                }
-                return;
+        field *f = find(key);
+        if (!f) {
+            add(key, value);
+        }
+        else if (f->value.empty()) {
+            f->value = value;
+        }
+    }
+
+    void clear() {
+        count = 0;
+        spill.clear();
+        heap_index.clear();
+        memset(inline_index, 0, sizeof(inline_index));
+    }
+
+    usize size() const { return count; }
+
+    field *begin() { return fields(); }
+    field *end()   { return fields() + count; }
+    const field *begin() const { return fields(); }
+    const field *end()   const { return fields() + count; }
+
+private:
+    static u32 hash_key(str_view key) {
+        // fnv-1a of the lowercase key
+        u32 hash = 2166136261u;
+        for (usize i = 0; i < key.len; ++i) {
+            hash ^= (u8)ascii_lower(key.buf[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    // the fields stay inline until there are too many, then all of them
+    // move to spill
+    field *fields() { return spill.len ? spill.buf : inline_fields; }
+    const field *fields() const { return spill.len ? spill.buf : inline_fields; }
+
+    // open addressing table of indices into fields() + 1, 0 is empty.
+    // it's kept at most half full so probing always ends
+    u16 *index() { return heap_index.len ? heap_index.buf : inline_index; }
+    const u16 *index() const { return heap_index.len ? heap_index.buf : inline_index; }
+    usize index_len() const { return heap_index.len ? heap_index.len : header_map_inline * 2; }
+
+    void add(str_view key, str_view value) {
+        // the index is u16 and the table grows by doubling
+        assert(count < 0x7fff);
+
+        field f = { key, value, hash_key(key) };
+        if (count < header_map_inline && !spill.len) {
+            inline_fields[count] = f;
+        }
+        else {
+            if (!spill.len) {
+                spill.reserve(header_map_inline * 2);
+                for (usize i = 0; i < count; ++i) spill.append(inline_fields[i]);
             }
+            spill.append(f);
+        }
+        ++count;
+
+        if (count * 2 > index_len()) {
+            rebuild_index(index_len() * 2);
+        }
+        else {
+            insert_index(count - 1);
         }
-        data.append({ key, value });
     }
 
-    struct str_pair {
-        str key;
-        str value;
-    };
+    void insert_index(usize entry) {
+        u16 *table = index();
+        usize mask = index_len() - 1;
+        usize i = fields()[entry].hash & mask;
+        while (table[i] != 0) i = (i + 1) & mask;
+        table[i] = (u16)(entry + 1);
+    }
 
-    str_pair *begin() { return data.begin(); }
-    str_pair *end()   { return data.end(); }
+    void rebuild_index(usize len) {
+        heap_index.clear();
+        heap_index.resize(len, 0);
+        for (usize i = 0; i < count; ++i) {
+            insert_index(i);
+        }
+    }
 
-    vec<str_pair> data;
-};
\ No newline at end of file
+    field inline_fields[header_map_inline];
+    u16 inline_index[header_map_inline * 2] = {};
+    vec<field> spill;
+    vec<u16> heap_index;
+    usize count = 0;
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "defines.h"
+
+// fixed capacity FIFO with any number of producers and a single consumer,
+// the consumer never blocks and neither side ever takes a lock or
+// allocates while there's room.
+// every cell has a sequence number saying whose turn it is: a producer
+// claims a cell by moving tail forward, writes the value and publishes it
+// with a release store of the sequence, the consumer sees it with an
+// acquire load and gives the cell back to the producers the same way.
+// when the ring is full push waits on a condition variable (that's the
+// backpressure), the consumer only takes the lock if somebody is waiting.
+// once closed push returns false, try_pop still drains what's left.
+// capacity is rounded up to a power of two, items are copied with plain
+// assignment
+template<typename T>
+struct mpsc_ring {
+    mpsc_ring() = default;
+    mpsc_ring(const mpsc_ring &other) = delete;
+    mpsc_ring &operator=(const mpsc_ring &other) = delete;
+
+    ~mpsc_ring() {
+        delete[] cells;
+        cells = nullptr;
+    }
+
+    // not thread safe, call it before the producers start
+    void init(usize capacity) {
+        usize cap = 1;
+        while (cap < capacity) cap *= 2;
+
+        delete[] cells;
+        cells = new cell[cap];
+        for (usize i = 0; i < cap; ++i) {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        mask = cap - 1;
+        head = 0;
+        popped.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        closed.store(false, std::memory_order_relaxed);
+    }
+
+    // returns false if the ring is full
+    bool try_push(const T &value) {
+        usize pos = tail.load(std::memory_order_relaxed);
+        cell *c = nullptr;
+        while (true) {
+            c = &cells[pos & mask];
+            usize seq = c->seq.load(std::memory_order_acquire);
+            isize diff = (isize)seq - (isize)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                // the consumer didn't get to this cell yet
+                return false;
+            }
+            else {
+                // somebody else took it
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        c->value = value;
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // waits while the ring is full, returns false once it's closed
+    bool push(const T &value) {
+        if (closed.load(std::memory_order_acquire)) return false;
+        if (try_push(value)) return true;
+
+        std::unique_lock<std::mutex> lock(mtx);
+        waiting.fetch_add(1);
+        // pairs with the fence in try_pop: either we see the cell it just
+        // freed or it sees us waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool pushed = false;
+        while (!closed.load(std::memory_order_acquire)) {
+            if ((pushed = try_push(value))) break;
+            not_full.wait(lock);
+        }
+        waiting.fetch_sub(1);
+        return pushed;
+    }
+
+    // consumer only, never blocks
+    bool try_pop(T &out) {
+        cell &c = cells[head & mask];
+        usize seq = c.seq.load(std::memory_order_acquire);
+        if (seq != head + 1) return false;
+
+        out = c.value;
+        c.seq.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        popped.store(head, std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed) > 0) {
+            // taking the lock makes sure the producer is inside wait()
+            std::lock_guard<std::mutex> lock(mtx);
+            not_full.notify_one();
+        }
+        return true;
+    }
+
+    // wakes up every waiting producer
+    void close() {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mtx);
+        not_full.notify_all();
+    }
+
+    // only a hint while the producers are running
+    usize size() const {
+        usize t = tail.load(std::memory_order_relaxed);
+        usize h = popped.load(std::memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+
+    usize capacity() const {
+        return mask + 1;
+    }
+
+private:
+    struct cell {
+        std::atomic<usize> seq;
+        T value;
+    };
+
+    cell *cells = nullptr;
+    usize mask = 0;
+    // producers and consumer write to different cache lines
+    alignas(64) std::atomic<usize> tail = 0;
+    alignas(64) usize head = 0;
+    // copy of head for size(), which can be called from any thread
+    std::atomic<usize> popped = 0;
+    std::atomic<int> waiting = 0;
+    std::atomic<bool> closed = false;
+
+    std::mutex mtx;
+    std::condition_variable not_full;
+};
@@ -6,7 +6,19 @@
 
 #include <stdio.h>
 
+#ifdef XMALLOC_STATS
+#include <atomic>
+
+static std::atomic<uint64_t> alloc_count;
+static std::atomic<uint64_t> alloc_bytes;
+
+#define XMALLOC_COUNT(size) (++alloc_count, alloc_bytes += (size))
+#else
+#define XMALLOC_COUNT(size)
+#endif
+
 void *xmalloc(size_t size) {
+    XMALLOC_COUNT(size);
     void *ptr = malloc(size);
     if (!ptr) {
         abort();
@@ -15,6 +27,7 @@ void *xmalloc(size_t size) {
 }
 
 void *xcalloc(size_t nmemb, size_t size) {
+    XMALLOC_COUNT(nmemb * size);
     void *ptr = calloc(nmemb, size);
     if (!ptr) {
         abort();
@@ -23,9 +36,18 @@ void *xcalloc(size_t nmemb, size_t size) {
 }
 
 void *xrealloc(void *ptr, size_t newsize) {
+    XMALLOC_COUNT(newsize);
     void *newptr = realloc(ptr, newsize);
     if (!newptr) {
         abort();
     }
     return newptr;
 }
+
+xmalloc_stats xmalloc_get_stats() {
+#ifdef XMALLOC_STATS
+    return { alloc_count.load(), alloc_bytes.load() };
+#else
+    return { 0, 0 };
+#endif
+}
@@ -9,4 +9,12 @@
 
 void *xmalloc(size_t size);
 void *xcalloc(size_t nmemb, size_t size);
-void *xrealloc(void *ptr, size_t newsize);
\ No newline at end of file
+void *xrealloc(void *ptr, size_t newsize);
+
+// only counted when compiled with XMALLOC_STATS, used by the benchmarks
+struct xmalloc_stats {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+xmalloc_stats xmalloc_get_stats();
\ No newline at end of file